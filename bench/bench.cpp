@@ -0,0 +1,615 @@
+#include "tgen.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <new>
+#include <numeric>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/*
+ * Benchmarks for tgen.
+ *
+ * Opts:
+ * --mode=m          `micro` (default) or `scaling`.
+ * --filter=str      only runs benchmarks whose name contains str.
+ * --min-time=t      minimum time in seconds of each measurement (default 0.1).
+ * --reps=k          number of measurements, the best is kept (default 5).
+ * --out=path        writes results as JSON to path.
+ * --compare=path    compares against the JSON results in path.
+ * --threshold=x     relative slowdown considered a regression (default 0.1).
+ *
+ * Scaling mode opts:
+ * --min-size=n      smallest size of the sweep (default 1e3).
+ * --max-size=n      largest size of the sweep (default 1e8).
+ * --timeout=t       time limit in seconds for each size (default 60).
+ * --max-bytes-per-element=b   budget of peak heap bytes per element
+ *                             (default 64).
+ * --max-exponent=e  budget of the fitted time and memory exponents
+ *                   (default 1.2).
+ *
+ * Exits with 1 if a regression was found or a budget was exceeded.
+ */
+
+/*
+ * Allocation counting.
+ */
+
+std::atomic<long long> alloc_count{0}, alloc_live{0}, alloc_peak{0};
+
+// Every block is prefixed by its size, so that frees can be counted.
+constexpr std::size_t alloc_header = alignof(std::max_align_t);
+
+void *operator new(std::size_t size) {
+	char *block = static_cast<char *>(std::malloc(size + alloc_header));
+	if (!block)
+		throw std::bad_alloc();
+	*reinterpret_cast<std::size_t *>(block) = size;
+
+	alloc_count.fetch_add(1, std::memory_order_relaxed);
+	long long live =
+		alloc_live.fetch_add(size, std::memory_order_relaxed) + size;
+	long long peak = alloc_peak.load(std::memory_order_relaxed);
+	while (live > peak and !alloc_peak.compare_exchange_weak(
+							   peak, live, std::memory_order_relaxed))
+		;
+	return block + alloc_header;
+}
+
+void operator delete(void *ptr) noexcept {
+	if (!ptr)
+		return;
+	char *block = static_cast<char *>(ptr) - alloc_header;
+	alloc_live.fetch_sub(*reinterpret_cast<std::size_t *>(block),
+						 std::memory_order_relaxed);
+	std::free(block);
+}
+
+// Prevents the compiler from optimizing away value.
+template <typename T> void keep(const T &value) {
+	asm volatile("" : : "g"(&value) : "memory");
+}
+
+struct bench_result {
+	std::string name;
+	double ns_per_op; // Nanoseconds per call of the benchmarked function.
+	long long iterations;
+};
+
+struct bench_runner {
+	std::string filter;
+	double min_time;
+	int reps;
+	std::vector<bench_result> results;
+
+	// Measures f, calling it repeatedly until min_time is reached, and keeps
+	// the best of reps measurements.
+	void run(const std::string &name, const std::function<void()> &f) {
+		if (name.find(filter) == std::string::npos)
+			return;
+		using clock = std::chrono::steady_clock;
+
+		long long iterations = 1;
+		double best = 1e100;
+		for (int rep = 0; rep < reps; ++rep) {
+			while (true) {
+				auto start = clock::now();
+				for (long long i = 0; i < iterations; ++i)
+					f();
+				double elapsed =
+					std::chrono::duration<double>(clock::now() - start)
+						.count();
+				if (elapsed >= min_time) {
+					best = std::min(best, 1e9 * elapsed / iterations);
+					break;
+				}
+				// Calibrates the number of iterations to reach min_time.
+				iterations = elapsed <= 0 ? iterations * 10
+										  : std::max<long long>(
+												iterations + 1,
+												iterations * 1.2 * min_time /
+													elapsed);
+			}
+		}
+
+		results.push_back({name, best, iterations});
+		std::cerr << std::left << std::setw(48) << name << std::right
+				  << std::setw(16) << std::fixed << std::setprecision(1)
+				  << best << " ns/op" << std::endl;
+	}
+};
+
+std::string to_json(const std::vector<bench_result> &results) {
+	std::ostringstream out;
+	out << "{\n  \"tgen_version\": \"" << TGEN_VERSION
+		<< "\",\n  \"benchmarks\": [\n";
+	for (std::size_t i = 0; i < results.size(); ++i) {
+		out << "    {\"name\": \"" << results[i].name
+			<< "\", \"ns_per_op\": " << std::setprecision(17)
+			<< results[i].ns_per_op
+			<< ", \"iterations\": " << results[i].iterations << "}"
+			<< (i + 1 < results.size() ? "," : "") << "\n";
+	}
+	out << "  ]\n}\n";
+	return out.str();
+}
+
+// Reads the results written by `to_json`.
+std::map<std::string, double> from_json(const std::string &path) {
+	std::ifstream file(path);
+	tgen_ensure(file, "could not open " + path);
+	std::stringstream buffer;
+	buffer << file.rdbuf();
+	std::string json = buffer.str();
+
+	std::map<std::string, double> ns_per_op;
+	const std::string name_key = "\"name\": \"", ns_key = "\"ns_per_op\": ";
+	for (std::size_t pos = json.find(name_key); pos != std::string::npos;
+		 pos = json.find(name_key, pos)) {
+		pos += name_key.size();
+		std::size_t end = json.find('"', pos);
+		std::string name = json.substr(pos, end - pos);
+		pos = json.find(ns_key, end) + ns_key.size();
+		ns_per_op[name] = std::stod(json.substr(pos));
+	}
+	return ns_per_op;
+}
+
+// Prints the comparison with the baseline. Returns if there was a regression.
+bool compare(const std::vector<bench_result> &results,
+			 const std::map<std::string, double> &baseline, double threshold) {
+	bool regression = false;
+	std::cerr << "\n"
+			  << std::left << std::setw(48) << "benchmark" << std::right
+			  << std::setw(14) << "baseline" << std::setw(14) << "current"
+			  << std::setw(10) << "change" << std::endl;
+	for (const bench_result &result : results) {
+		auto it = baseline.find(result.name);
+		if (it == baseline.end())
+			continue;
+		double change = result.ns_per_op / it->second - 1;
+		bool slower = change > threshold;
+		regression |= slower;
+		std::cerr << std::left << std::setw(48) << result.name << std::right
+				  << std::fixed << std::setprecision(1) << std::setw(14)
+				  << it->second << std::setw(14) << result.ns_per_op
+				  << std::setw(9) << std::showpos << 100 * change
+				  << std::noshowpos << "%" << (slower ? "  REGRESSION" : "")
+				  << std::endl;
+	}
+	return regression;
+}
+
+/*
+ * Benchmarks.
+ */
+
+void bench_general(bench_runner &runner) {
+	runner.run("next<int>", [] { keep(tgen::next<int>(1, 1000000000)); });
+	runner.run("next<long long>", [] {
+		keep(tgen::next<long long>(1, 1000000000000000000LL));
+	});
+	runner.run("next<float>", [] { keep(tgen::next<float>(0, 1)); });
+	runner.run("next<double>", [] { keep(tgen::next<double>(0, 1)); });
+
+	std::vector<int> v(100000);
+	std::iota(v.begin(), v.end(), 0);
+	runner.run("shuffle/1e5", [&] {
+		tgen::shuffle(v.begin(), v.end());
+		keep(v);
+	});
+	runner.run("choose/5e4_of_1e5", [&] { keep(tgen::choose(50000, v)); });
+}
+
+void bench_distinct_values(bench_runner &runner) {
+	// Density regimes: k values out of a range of size r-l+1.
+	struct regime {
+		std::string name;
+		int k, l, r, forbidden;
+	};
+	for (auto [name, k, l, r, forbidden] : std::vector<regime>{
+			 {"sparse/1e3_of_1e9", 1000, 1, 1000000000, 0},
+			 {"medium/1e5_of_1e6", 100000, 1, 1000000, 0},
+			 {"dense/1e5_of_1e5", 100000, 1, 100000, 0},
+			 {"forbidden/1e4_of_2e4_1e4", 10000, 1, 20000, 10000}}) {
+		tgen::sequence<int> seq(1, l, r);
+		std::set<int> forbidden_values;
+		for (int i = 0; i < forbidden; ++i)
+			forbidden_values.insert(l + 2 * i);
+		runner.run("generate_distinct_values/" + name, [&, k = k] {
+			keep(seq.generate_distinct_values(k, forbidden_values));
+		});
+	}
+}
+
+void bench_sequence(bench_runner &runner) {
+	const int n = 100000;
+	runner.run("sequence/plain/1e5",
+			   [&] { keep(tgen::sequence<int>(n, 1, 1000000000).gen()); });
+	runner.run("sequence/value_set/1e5", [&] {
+		keep(tgen::sequence<char>(n, {'A', 'C', 'G', 'T'}).gen());
+	});
+
+	{
+		auto seq = tgen::sequence<int>(n, 1, 1000000000);
+		for (int i = 0; i < n; i += 2)
+			seq.set(i, i + 1);
+		runner.run("sequence/set/1e5", [&] { keep(seq.gen()); });
+	}
+	{
+		auto seq = tgen::sequence<int>(n, 1, 1000000000);
+		for (int i = 0; i + 1 < n; i += 2)
+			seq.equal(i, n - 1 - i);
+		runner.run("sequence/equal/1e5", [&] { keep(seq.gen()); });
+	}
+	{
+		auto seq = tgen::sequence<int>(n, 1, 1000000000);
+		for (int i = 0; i + 100 <= n; i += 100)
+			seq.equal_range(i, i + 99);
+		runner.run("sequence/equal_range/1e5", [&] { keep(seq.gen()); });
+	}
+	{
+		auto seq = tgen::sequence<int>(n, 1, 1000000000).distinct();
+		runner.run("sequence/distinct/1e5", [&] { keep(seq.gen()); });
+	}
+	{
+		auto seq = tgen::sequence<int>(n, 1, n).distinct();
+		runner.run("sequence/distinct_dense/1e5", [&] { keep(seq.gen()); });
+	}
+	{
+		auto seq = tgen::sequence<char>(n, {'A', 'C', 'G', 'T'});
+		for (int i = 1; i < n; ++i)
+			seq.different(i - 1, i);
+		runner.run("sequence/different_chain/1e5", [&] { keep(seq.gen()); });
+	}
+	{
+		// Values 1 to n/2 twice each.
+		auto seq = tgen::sequence<int>(n, 1, n);
+		for (int value = 1; value <= n / 2; ++value)
+			seq.count(value, 2);
+		runner.run("sequence/count/1e5", [&] { keep(seq.gen()); });
+	}
+
+	{
+		auto inst = tgen::sequence<int>(n, 1, 1000000000).gen();
+		runner.run("sequence/instance_sort/1e5", [&] {
+			auto copy = inst;
+			keep(copy.sort());
+		});
+	}
+
+	{
+		auto inst = tgen::lazy_sequence<int>(1e10, 1, 1000000000).gen();
+		long long idx = 0;
+		runner.run("lazy_sequence/access", [&] {
+			keep(inst[idx]);
+			idx = (idx + 999999937) % inst.size();
+		});
+	}
+
+	{
+		auto inst = tgen::lazy_permutation(1e10).gen();
+		long long idx = 0;
+		runner.run("lazy_permutation/access", [&] {
+			keep(inst[idx]);
+			idx = (idx + 999999937) % inst.size();
+		});
+	}
+
+	{
+		// Text against binary output of the same instance.
+		auto inst = tgen::sequence<int>(n, 1, 1000000000).gen();
+		runner.run("sequence/print_text/1e5", [&] {
+			std::ostringstream out;
+			out << inst;
+			keep(out.tellp());
+		});
+		runner.run("sequence/write_binary/1e5", [&] {
+			std::ostringstream out;
+			tgen::write_binary(out, inst);
+			keep(out.tellp());
+		});
+
+		// Parsing the printed instance back.
+		std::string path =
+			(std::filesystem::temp_directory_path() / "tgen_bench.txt")
+				.string();
+		std::ofstream(path) << inst;
+		auto seq = tgen::sequence<int>(n, 1, 1000000000);
+		runner.run("sequence/read/1e5", [&] {
+			tgen::reader in(path);
+			keep(seq.read(in));
+		});
+		std::filesystem::remove(path);
+	}
+
+	// Tiny instances, as generated in tight loops.
+	runner.run("sequence/tiny_distinct/3", [&] {
+		keep(tgen::sequence<int>(3, 1, 1000000000).distinct().gen());
+	});
+	runner.run("static_sequence/tiny_distinct/3", [&] {
+		keep(tgen::static_sequence<int, 3>(1, 1000000000).distinct().gen());
+	});
+}
+
+void bench_permutation(bench_runner &runner) {
+	const int n = 100000;
+	runner.run("permutation/plain/1e5",
+			   [&] { keep(tgen::permutation(n).gen()); });
+	std::vector<int> cycle_sizes(100, n / 100);
+	runner.run("permutation/cycles/1e5",
+			   [&] { keep(tgen::permutation(n).gen(cycle_sizes)); });
+	// Acceptance rate 1/1000: all but the first candidate on worker threads.
+	runner.run("permutation/gen_until/1e3", [&] {
+		keep(tgen::permutation(1000).gen_until_parallel(
+			[](const auto &perm) { return perm[0] == 0; }, 1000000));
+	});
+}
+
+void bench_string(bench_runner &runner) {
+	const int n = 100000;
+	// Against a sequence of the same characters, that draws once per value.
+	runner.run("string/plain/1e5",
+			   [&] { keep(tgen::string(n, 'a', 'z').gen()); });
+	runner.run("string/sequence_char/1e5",
+			   [&] { keep(tgen::sequence<char>(n, 'a', 'z').gen()); });
+	runner.run("string/dna/1e5", [&] {
+		keep(tgen::string(n, {'A', 'C', 'G', 'T'}).gen());
+	});
+	runner.run("string/palindrome/1e5",
+			   [&] { keep(tgen::string(n, 'a', 'z').palindrome().gen()); });
+}
+
+void bench_partition(bench_runner &runner) {
+	runner.run("partition/plain/1e6",
+			   [&] { keep(tgen::partition(1000000).gen()); });
+	runner.run("partition/max_part/1e6",
+			   [&] { keep(tgen::partition(1000000).max_part(100).gen()); });
+	runner.run("partition/parts/1e6",
+			   [&] { keep(tgen::partition(1000000).parts(1000).gen()); });
+	// Permutation with the cycle sizes of a random partition.
+	runner.run("partition/cycle_type/1e5", [&] {
+		keep(tgen::permutation(100000).gen(tgen::partition(100000).gen()));
+	});
+}
+
+void bench_tree(bench_runner &runner) {
+	runner.run("tree/uniform/1e5", [&] { keep(tgen::tree(100000).gen()); });
+	runner.run("tree/uniform/1e7", [&] { keep(tgen::tree(10000000).gen()); });
+	runner.run("tree/max_depth/1e5",
+			   [&] { keep(tgen::tree(100000).max_depth(10).gen()); });
+
+	// Edges through the writer, against printing them with `operator<<`.
+	auto inst = tgen::tree(100000).gen();
+	runner.run("tree/print/1e5", [&] {
+		std::ostringstream out;
+		out << inst;
+		keep(out.tellp());
+	});
+	runner.run("tree/print_ostream/1e5", [&] {
+		std::ostringstream out;
+		for (auto [u, v] : inst.edges())
+			out << u << ' ' << v << '\n';
+		keep(out.tellp());
+	});
+}
+
+void bench_graph(bench_runner &runner) {
+	runner.run("graph/sparse/1e5",
+			   [&] { keep(tgen::graph(100000, 100000).gen()); });
+	runner.run("graph/connected/1e5",
+			   [&] { keep(tgen::graph(100000, 100000).connected().gen()); });
+	// 80% of the pairs of 5000 vertices.
+	runner.run("graph/dense/1e7", [&] { keep(tgen::graph(5000, 1e7).gen()); });
+}
+
+void bench_multitest(bench_runner &runner) {
+	// 1000 cases with sum of sizes 2e5, against the loop it replaces.
+	auto print_case = [](std::ostream &out, long long size) {
+		out << size << '\n' << tgen::sequence<int>(size, 1, 1000000000).gen();
+	};
+	runner.run("multitest/print/2e5", [&] {
+		std::ostringstream out;
+		tgen::multitest(1000, 200000).print(print_case, out);
+		keep(out.tellp());
+	});
+	runner.run("multitest/loop/2e5", [&] {
+		std::ostringstream out;
+		auto sizes = tgen::multitest(1000, 200000).sizes();
+		out << sizes.size() << '\n';
+		for (long long size : sizes) {
+			print_case(out, size);
+			out << '\n';
+		}
+		keep(out.tellp());
+	});
+}
+
+/*
+ * Scaling.
+ */
+
+struct scaling_result {
+	double seconds;
+	long long peak_rss;	  // Growth of the peak RSS, in bytes.
+	long long peak_heap;  // Peak of live heap bytes.
+	long long allocs;	  // Number of allocations.
+	bool ok;			  // If it finished in time.
+};
+
+long long current_rss() {
+	long long pages = 0, resident = 0;
+	std::ifstream("/proc/self/statm") >> pages >> resident;
+	return resident * sysconf(_SC_PAGESIZE);
+}
+
+// Runs f in a child process, so that its peak RSS is isolated.
+scaling_result measure(const std::function<void()> &f, int timeout) {
+	int fds[2];
+	tgen_ensure(pipe(fds) == 0, "could not create pipe");
+	pid_t pid = fork();
+	tgen_ensure(pid >= 0, "could not fork");
+
+	if (pid == 0) {
+		close(fds[0]);
+		alarm(timeout);
+		long long rss_before = current_rss(), live_before = alloc_live;
+		alloc_count = 0, alloc_peak = live_before;
+
+		auto start = std::chrono::steady_clock::now();
+		f();
+		scaling_result result;
+		result.seconds = std::chrono::duration<double>(
+							 std::chrono::steady_clock::now() - start)
+							 .count();
+
+		rusage usage;
+		getrusage(RUSAGE_SELF, &usage);
+		result.peak_rss =
+			std::max(0LL, usage.ru_maxrss * 1024LL - rss_before);
+		result.peak_heap = alloc_peak - live_before;
+		result.allocs = alloc_count;
+		result.ok = true;
+		tgen_ensure(write(fds[1], &result, sizeof(result)) == sizeof(result));
+		_exit(0);
+	}
+
+	close(fds[1]);
+	scaling_result result{};
+	if (read(fds[0], &result, sizeof(result)) != sizeof(result))
+		result.ok = false; // Killed by the timeout, or out of memory.
+	close(fds[0]);
+	waitpid(pid, nullptr, 0);
+	return result;
+}
+
+// Least squares slope of log(y) on log(x).
+double fit_exponent(const std::vector<double> &x,
+					const std::vector<double> &y) {
+	double n = x.size(), sx = 0, sy = 0, sxx = 0, sxy = 0;
+	for (std::size_t i = 0; i < x.size(); ++i) {
+		double lx = std::log(x[i]), ly = std::log(std::max(y[i], 1e-12));
+		sx += lx, sy += ly, sxx += lx * lx, sxy += lx * ly;
+	}
+	return (n * sxy - sx * sy) / (n * sxx - sx * sx);
+}
+
+// Sweeps the sizes for every case. Returns if a budget was exceeded.
+bool scaling() {
+	long long min_size = tgen::opt<double>("min-size", 1e3);
+	long long max_size = tgen::opt<double>("max-size", 1e8);
+	int timeout = tgen::opt<int>("timeout", 60);
+	double max_bytes = tgen::opt<double>("max-bytes-per-element", 64);
+	double max_exponent = tgen::opt<double>("max-exponent", 1.2);
+	std::string filter = tgen::opt<std::string>("filter", "");
+
+	std::vector<std::pair<std::string, std::function<void(int)>>> cases = {
+		{"sequence/plain",
+		 [](int n) { keep(tgen::sequence<int>(n, 1, 1000000000).gen()); }},
+		{"sequence/distinct",
+		 [](int n) {
+			 keep(tgen::sequence<int>(n, 1, 1000000000).distinct().gen());
+		 }},
+		{"sequence/instance_sort",
+		 [](int n) {
+			 keep(tgen::sequence<int>(n, 1, 1000000000).gen().sort());
+		 }},
+		{"permutation/plain", [](int n) { keep(tgen::permutation(n).gen()); }},
+	};
+
+	bool exceeded = false;
+	for (auto &[name, run] : cases) {
+		if (name.find(filter) == std::string::npos)
+			continue;
+		std::cout << "\n"
+				  << name << "\n"
+				  << std::setw(12) << "size" << std::setw(12) << "time (s)"
+				  << std::setw(14) << "rss (MB)" << std::setw(14)
+				  << "heap (MB)" << std::setw(12) << "bytes/elem"
+				  << std::setw(12) << "allocs" << std::endl;
+
+		std::vector<double> sizes, times, heaps;
+		for (long long n = min_size; n <= max_size; n *= 10) {
+			scaling_result result = measure([&, n = n] { run(n); }, timeout);
+			std::cout << std::setw(12) << n;
+			if (!result.ok) {
+				std::cout << "    failed (timeout or out of memory)"
+						  << std::endl;
+				exceeded = true;
+				break;
+			}
+			double bytes_per_element = double(result.peak_heap) / n;
+			std::cout << std::fixed << std::setprecision(4) << std::setw(12)
+					  << result.seconds << std::setprecision(1)
+					  << std::setw(14) << result.peak_rss / 1e6
+					  << std::setw(14) << result.peak_heap / 1e6
+					  << std::setw(12) << bytes_per_element << std::setw(12)
+					  << result.allocs << std::endl;
+			if (bytes_per_element > max_bytes) {
+				std::cout << "    over budget of " << max_bytes
+						  << " bytes per element" << std::endl;
+				exceeded = true;
+			}
+			sizes.push_back(n), times.push_back(result.seconds);
+			heaps.push_back(result.peak_heap);
+		}
+
+		if (sizes.size() >= 2) {
+			double time_exp = fit_exponent(sizes, times);
+			double memory_exp = fit_exponent(sizes, heaps);
+			std::cout << std::setprecision(2) << "time exponent: " << time_exp
+					  << ", memory exponent: " << memory_exp << std::endl;
+			if (std::max(time_exp, memory_exp) > max_exponent) {
+				std::cout << "    over budget of exponent " << max_exponent
+						  << std::endl;
+				exceeded = true;
+			}
+		}
+	}
+	return exceeded;
+}
+
+int main(int argc, char **argv) {
+	tgen::register_gen(argc, argv);
+
+	if (tgen::opt<std::string>("mode", "micro") == "scaling")
+		return scaling();
+
+	bench_runner runner{tgen::opt<std::string>("filter", ""),
+						tgen::opt<double>("min-time", 0.1),
+						tgen::opt<int>("reps", 5),
+						{}};
+
+	bench_general(runner);
+	bench_distinct_values(runner);
+	bench_sequence(runner);
+	bench_permutation(runner);
+	bench_string(runner);
+	bench_partition(runner);
+	bench_tree(runner);
+	bench_graph(runner);
+	bench_multitest(runner);
+
+	if (tgen::has_opt("out"))
+		std::ofstream(tgen::opt<std::string>("out")) << to_json(runner.results);
+
+	if (tgen::has_opt("compare") and
+		compare(runner.results, from_json(tgen::opt<std::string>("compare")),
+				tgen::opt<double>("threshold", 0.1)))
+		return 1;
+}
@@ -1,16 +1,48 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <fstream>
 #include <iostream>
+#include <limits>
 #include <map>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <numeric>
 #include <optional>
 #include <queue>
 #include <random>
 #include <set>
+#include <sstream>
 #include <stdexcept>
 #include <string>
+#include <thread>
+#include <tuple>
+#include <utility>
 #include <vector>
 
+#if __has_include(<sys/mman.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define TGEN_MMAP_INTERNAL
+#endif
+
+// Version of tgen. Outputs may change between versions.
+#define TGEN_VERSION "1.1.0"
+
 namespace tgen {
 
 /**************************
@@ -43,33 +75,387 @@ inline void contradiction_error_internal(const std::string &type,
 	throw error_internal(error_msg);
 }
 
+// Thrown by a solver when constraints are too complex for it, so that a more
+// general one is used.
+struct complex_constraints_internal {};
+
 // Ensures condition is true, with nice debug.
 #define tgen_ensure(cond, ...)                                                 \
 	if (!(cond))                                                               \
 		tgen::throw_assertion_error_internal(#cond, ##__VA_ARGS__);
 
+/*
+ * Runtime stats.
+ *
+ * Counters of what the generators spend time on. Counting is compiled out
+ * unless `TGEN_STATS` is defined before including tgen.h. Running the generator
+ * with `--tgen-stats` prints the counters to stderr at exit.
+ *
+ * Allocations are counted by replacing the global `operator new`, which can
+ * only be done once per program: a single translation unit must expand
+ * `tgen_count_allocations()` at global scope. Without `TGEN_STATS`, it expands
+ * to nothing.
+ */
+
+namespace stats {
+
+// Categories of call sites of random draws.
+enum category {
+	user,			 // Direct calls to `tgen::next`.
+	shuffle,		 // `tgen::shuffle`.
+	any,			 // `tgen::any`.
+	choose,			 // `tgen::choose`.
+	sequence,		 // `tgen::sequence::gen`.
+	distinct_values, // `tgen::sequence::generate_distinct_values`.
+	permutation,	 // `tgen::permutation::gen`.
+	tree,			 // `tgen::tree::gen`.
+	graph,			 // `tgen::graph::gen`.
+	partition,		 // `tgen::partition::gen`.
+	category_count
+};
+inline const char *category_names[category_count] = {
+	"user",			   "shuffle",	  "any",  "choose", "sequence",
+	"distinct_values", "permutation", "tree", "graph",	"partition"};
+
+// Bits of the constraint class of a `tgen::sequence::gen` call.
+enum constraint_bit { set_bit = 1, equal_bit = 2, distinct_bit = 4 };
+
+inline std::atomic<unsigned long long>
+	rng_draws[category_count]; // Random draws per category.
+inline std::atomic<unsigned long long> gen_until_attempts,
+	gen_until_accepted; // Candidates of `gen_until`, and how many passed.
+inline std::atomic<unsigned long long>
+	sequence_gen[8]; // `tgen::sequence::gen` calls per constraint class.
+inline std::atomic<unsigned long long> distinct_values_calls,
+	distinct_values_forbidden; // Calls of `generate_distinct_values`, and
+							   // the total size of their forbidden sets.
+inline std::atomic<unsigned long long> allocations,
+	bytes_allocated; // Calls of `operator new`, and bytes requested.
+
+// Allocates memory for the replaced `operator new`, counting it.
+inline void *counted_new_internal(std::size_t size) {
+	++allocations;
+	bytes_allocated += size;
+	if (void *ptr = std::malloc(size ? size : 1))
+		return ptr;
+	throw std::bad_alloc();
+}
+
+// Frees memory of `counted_new_internal`. Not inlined, so that the compiler
+// does not see `free` called on memory of a `new` expression.
+[[gnu::noinline]] inline void counted_delete_internal(void *ptr) noexcept {
+	std::free(ptr);
+}
+
+// Resets all counters.
+inline void reset() {
+	for (auto &draws : rng_draws)
+		draws = 0;
+	for (auto &calls : sequence_gen)
+		calls = 0;
+	gen_until_attempts = gen_until_accepted = 0;
+	distinct_values_calls = distinct_values_forbidden = 0;
+	allocations = bytes_allocated = 0;
+}
+
+// Prints all counters.
+inline void dump(std::ostream &out) {
+	// Allocations before printing, which also allocates.
+	unsigned long long allocs = allocations, bytes = bytes_allocated;
+	out << "tgen stats:\n  rng draws:\n";
+	for (int i = 0; i < category_count; ++i)
+		if (rng_draws[i])
+			out << "    " << category_names[i] << ": " << rng_draws[i] << "\n";
+
+	out << "  gen_until: " << gen_until_attempts << " attempts, "
+		<< gen_until_accepted << " accepted";
+	if (gen_until_attempts)
+		out << " (acceptance rate "
+			<< 100.0 * gen_until_accepted / gen_until_attempts << "%)";
+	out << "\n";
+
+	out << "  sequence::gen calls:\n";
+	for (int mask = 0; mask < 8; ++mask)
+		if (sequence_gen[mask]) {
+			std::string name;
+			if (mask & set_bit)
+				name += "+set";
+			if (mask & equal_bit)
+				name += "+equal";
+			if (mask & distinct_bit)
+				name += "+distinct";
+			out << "    " << (name.empty() ? "none" : name.substr(1)) << ": "
+				<< sequence_gen[mask] << "\n";
+		}
+
+	out << "  generate_distinct_values: " << distinct_values_calls
+		<< " calls, " << distinct_values_forbidden << " forbidden values\n";
+	out << "  allocations: " << allocs << " (" << bytes << " bytes)\n";
+}
+
+}; // namespace stats
+
+#ifdef TGEN_STATS
+#define tgen_stats_internal(...) __VA_ARGS__
+#define tgen_count_allocations()                                               \
+	void *operator new(std::size_t size) {                                     \
+		return tgen::stats::counted_new_internal(size);                        \
+	}                                                                          \
+	void operator delete(void *ptr) noexcept {                                 \
+		tgen::stats::counted_delete_internal(ptr);                             \
+	}                                                                          \
+	void operator delete(void *ptr, std::size_t) noexcept {                    \
+		tgen::stats::counted_delete_internal(ptr);                             \
+	}
+#else
+#define tgen_stats_internal(...)
+#define tgen_count_allocations()
+#endif
+
+// Category of the random draws of the current thread.
+inline thread_local int stats_category_internal = stats::user;
+
+// Sets the category of random draws during its lifetime.
+struct stats_scope_internal {
+	int previous_;
+
+	stats_scope_internal(int category) : previous_(stats_category_internal) {
+		stats_category_internal = category;
+	}
+	~stats_scope_internal() { stats_category_internal = previous_; }
+};
+
+/*
+ * Phase tracing.
+ *
+ * Scoped timers around generator entry points and their phases, compiled out
+ * unless `TGEN_TRACE` is defined before including tgen.h. Running the
+ * generator with `--tgen-trace=file.json` writes the timings at exit in the
+ * Chrome trace event format, that can be opened in a trace viewer (such as
+ * `chrome://tracing` or Perfetto).
+ */
+
+// A complete trace event.
+struct trace_event_internal {
+	const char *name;
+	long long start_ns, duration_ns;
+	int thread;
+};
+
+inline std::mutex trace_mutex_internal;
+inline std::vector<trace_event_internal> trace_events_internal;
+inline const auto trace_start_internal = std::chrono::steady_clock::now();
+
+// Small id of the current thread, for the trace.
+inline int trace_thread_internal() {
+	static std::atomic<int> thread_count{0};
+	thread_local int thread = thread_count++;
+	return thread;
+}
+
+// Records the time between its construction and destruction as an event.
+struct trace_scope_internal {
+	const char *name_;
+	std::chrono::steady_clock::time_point start_;
+
+	trace_scope_internal(const char *name)
+		: name_(name), start_(std::chrono::steady_clock::now()) {}
+	~trace_scope_internal() {
+		auto end = std::chrono::steady_clock::now();
+		auto ns = [](auto duration) {
+			return static_cast<long long>(
+				std::chrono::duration_cast<std::chrono::nanoseconds>(duration)
+					.count());
+		};
+		std::lock_guard<std::mutex> lock(trace_mutex_internal);
+		trace_events_internal.push_back({name_,
+										 ns(start_ - trace_start_internal),
+										 ns(end - start_),
+										 trace_thread_internal()});
+	}
+};
+
+// Writes the trace events recorded so far.
+inline void trace_write_internal(std::ostream &out) {
+	std::lock_guard<std::mutex> lock(trace_mutex_internal);
+	out << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [";
+	for (std::size_t i = 0; i < trace_events_internal.size(); ++i) {
+		const trace_event_internal &event = trace_events_internal[i];
+		out << (i > 0 ? ",\n" : "\n") << "{\"name\": \"" << event.name
+			<< "\", \"cat\": \"tgen\", \"ph\": \"X\", \"pid\": 0, \"tid\": "
+			<< event.thread << ", \"ts\": " << event.start_ns / 1000 << "."
+			<< std::to_string(1000 + event.start_ns % 1000).substr(1)
+			<< ", \"dur\": " << event.duration_ns / 1000 << "."
+			<< std::to_string(1000 + event.duration_ns % 1000).substr(1)
+			<< "}";
+	}
+	out << "\n]}\n";
+}
+
+#define tgen_trace_concat_internal(a, b) a##b
+#define tgen_trace_name_internal(line)                                         \
+	tgen_trace_concat_internal(tgen_trace_scope_, line)
+#ifdef TGEN_TRACE
+#define tgen_trace_internal(name)                                              \
+	tgen::trace_scope_internal tgen_trace_name_internal(__LINE__)(name);
+#else
+#define tgen_trace_internal(name)
+#endif
+
 /*
  * Global random operations.
  */
 
-inline std::mt19937 rng_internal;
+// Random state, seeded by `register_gen` and shared by all threads.
+inline std::mt19937 rng_global_internal;
+// Random state of the calling thread while it generates from a random stream
+// (see `seed_stream_internal`), so that work split between threads does not
+// depend on them.
+inline thread_local std::optional<std::mt19937> rng_stream_internal;
 
-// Returns a random number in [l, r].
-template <typename T> T next(T l, T r) {
-	tgen_ensure(l <= r, "range for `next` bust be valid");
+// Random state of the calling thread: its stream, if any, or the global one.
+inline std::mt19937 &rng_internal() {
+	return rng_stream_internal ? *rng_stream_internal : rng_global_internal;
+}
+
+// Returns a random number in [l, r], drawn from `engine`.
+template <typename T, typename ENGINE>
+T next_internal(ENGINE &engine, T l, T r) {
 	if constexpr (std::is_integral_v<T>)
-		return std::uniform_int_distribution<T>(l, r)(rng_internal);
+		return std::uniform_int_distribution<T>(l, r)(engine);
 	else if constexpr (std::is_floating_point_v<T>)
-		return std::uniform_real_distribution<T>(l, r)(rng_internal);
+		return std::uniform_real_distribution<T>(l, r)(engine);
 	else
 		throw error_internal("invalid type for next (" +
 							 std::string(typeid(T).name()) + ")");
 }
 
+// Returns a random number in [l, r].
+template <typename T> T next(T l, T r) {
+	tgen_ensure(l <= r, "range for `next` bust be valid");
+	tgen_stats_internal(++stats::rng_draws[stats_category_internal];)
+	return next_internal(rng_internal(), l, r);
+}
+
+// Philox4x32-10, a counter-based generator (Salmon et al., "Parallel random
+// numbers: as easy as 1, 2, 3"). Each output block is a function of the key
+// and the counter, so streams (the high half of the counter) are independent,
+// and can be drawn in any order, on any thread.
+struct philox_internal {
+	using result_type = uint32_t;
+	std::array<uint32_t, 2> key_;
+	std::array<uint32_t, 4> counter_, out_;
+	int pos_ = 4; // Next word of `out_`.
+
+	philox_internal(uint64_t key, uint64_t stream, uint64_t offset = 0)
+		: key_{static_cast<uint32_t>(key), static_cast<uint32_t>(key >> 32)},
+		  counter_{static_cast<uint32_t>(offset),
+				   static_cast<uint32_t>(offset >> 32),
+				   static_cast<uint32_t>(stream),
+				   static_cast<uint32_t>(stream >> 32)} {}
+
+	static constexpr result_type min() { return 0; }
+	static constexpr result_type max() { return UINT32_MAX; }
+
+	// Output block of a counter.
+	static std::array<uint32_t, 4> block(std::array<uint32_t, 4> ctr,
+										 std::array<uint32_t, 2> key) {
+		for (int round = 0; round < 10; ++round) {
+			uint64_t prod_0 = 0xD2511F53ULL * ctr[0];
+			uint64_t prod_1 = 0xCD9E8D57ULL * ctr[2];
+			ctr = {static_cast<uint32_t>(prod_1 >> 32) ^ ctr[1] ^ key[0],
+				   static_cast<uint32_t>(prod_1),
+				   static_cast<uint32_t>(prod_0 >> 32) ^ ctr[3] ^ key[1],
+				   static_cast<uint32_t>(prod_0)};
+			key[0] += 0x9E3779B9, key[1] += 0xBB67AE85;
+		}
+		return ctr;
+	}
+
+	result_type operator()() {
+		if (pos_ == 4) {
+			out_ = block(counter_, key_), pos_ = 0;
+			if (++counter_[0] == 0)
+				++counter_[1];
+		}
+		return out_[pos_++];
+	}
+};
+
+// Seed sequence of the words of a Philox stream. Much faster than
+// `std::seed_seq` to seed a `std::mt19937`.
+struct philox_seed_internal {
+	using result_type = uint32_t;
+	uint64_t key_, stream_;
+
+	template <typename It> void generate(It first, It last) const {
+		philox_internal engine(key_, stream_);
+		for (; first != last; ++first)
+			*first = engine();
+	}
+};
+
+// Keyed pseudo-random bijection on [0, n): a Feistel network on the smallest
+// even number of bits that fits n, with cycle-walking back into [0, n) (Black
+// and Rogaway, "Ciphers with arbitrary finite domains"). The network covers
+// less than 4n values, so a value or its preimage takes O(1) expected time.
+struct feistel_internal {
+	static constexpr int rounds = 6;
+	uint64_t size_; // Size of the domain, 0 for 2^64.
+	int half_;		// Bits of each half.
+	uint64_t mask_; // Mask of a half.
+	std::array<uint64_t, rounds> keys_;
+
+	feistel_internal(uint64_t size, uint64_t key) : size_(size), half_(1) {
+		while (half_ < 32 and (size_ == 0 or (1ULL << 2 * half_) < size_))
+			++half_;
+		mask_ = (1ULL << half_) - 1;
+		for (uint64_t &round_key : keys_)
+			round_key = mix(key += 0x9E3779B97F4A7C15ULL);
+	}
+
+	// SplitMix64 finalizer.
+	static uint64_t mix(uint64_t z) {
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+		return z ^ (z >> 31);
+	}
+
+	uint64_t encrypt(uint64_t x) const {
+		uint64_t l = x >> half_, r = x & mask_;
+		for (int i = 0; i < rounds; ++i)
+			std::tie(l, r) = std::pair(r, l ^ (mix(r ^ keys_[i]) & mask_));
+		return l << half_ | r;
+	}
+	uint64_t decrypt(uint64_t x) const {
+		uint64_t l = x >> half_, r = x & mask_;
+		for (int i = rounds - 1; i >= 0; --i)
+			std::tie(l, r) = std::pair(r ^ (mix(l ^ keys_[i]) & mask_), l);
+		return l << half_ | r;
+	}
+
+	// Image of x.
+	uint64_t operator()(uint64_t x) const {
+		do
+			x = encrypt(x);
+		while (size_ != 0 and x >= size_);
+		return x;
+	}
+
+	// Preimage of x.
+	uint64_t inverse(uint64_t x) const {
+		do
+			x = decrypt(x);
+		while (size_ != 0 and x >= size_);
+		return x;
+	}
+};
+
 // Shuffles [first, last) inplace uniformly.
 template <typename It> void shuffle(It first, It last) {
 	if (first == last)
 		return;
+	tgen_stats_internal(stats_scope_internal scope(stats::shuffle);)
 
 	for (It i = first + 1; i != last; ++i)
 		std::iter_swap(i, first + next(0, static_cast<int>(i - first)));
@@ -84,6 +470,7 @@ template <typename C> [[nodiscard]] C shuffle(const C &container) {
 
 // Returns a random element from [first, last).
 template <typename It> typename It::value_type any(It first, It last) {
+	tgen_stats_internal(stats_scope_internal scope(stats::any);)
 	int size = std::distance(first, last);
 	It it = first;
 	std::advance(it, next(0, size - 1));
@@ -103,6 +490,7 @@ template <typename T> T any(const std::initializer_list<T> &il) {
 template <typename C> C choose(int k, const C &container) {
 	tgen_ensure(0 < k and k <= container.size(),
 				"number of elements to choose must be valid");
+	tgen_stats_internal(stats_scope_internal scope(stats::choose);)
 	std::vector<typename C::value_type> new_vec;
 	C new_container;
 	int need = k, left = container.size();
@@ -119,20 +507,445 @@ std::vector<T> choose(int k, const std::initializer_list<T> &il) {
 	return choose(k, std::vector<T>(il.begin(), il.end()));
 }
 
+/*
+ * Scratch memory.
+ */
+
+// Memory resource for the temporary data of generators, unless they are given
+// one. Small blocks are carved from large chunks and recycled through a free
+// list per size class, and chunks are kept between generations, so that
+// repeated generation does almost no heap allocation. Large blocks go to the
+// heap.
+struct scratch_arena_internal : std::pmr::memory_resource {
+	static constexpr std::size_t granularity = 16;	  // Size class step.
+	static constexpr std::size_t max_small = 1 << 12; // Largest small block.
+	static constexpr std::size_t chunk_size = 1 << 16;
+	static constexpr std::size_t max_kept =
+		1 << 26; // Chunks are freed after a generation if they exceed this.
+
+	std::vector<std::unique_ptr<std::byte[]>> chunks_;
+	std::byte *cur_ = nullptr, *end_ = nullptr; // Free part of last chunk.
+	void *free_[max_small / granularity + 1] = {}; // Free list of each class.
+	int depth_ = 0; // Number of generations using the arena.
+
+	void *do_allocate(std::size_t bytes, std::size_t align) override {
+		if (bytes > max_small or align > granularity)
+			return std::pmr::new_delete_resource()->allocate(bytes, align);
+
+		std::size_t cls = std::max<std::size_t>(
+			1, (bytes + granularity - 1) / granularity);
+		if (void *ptr = free_[cls]) {
+			free_[cls] = *static_cast<void **>(ptr);
+			return ptr;
+		}
+		std::size_t size = cls * granularity;
+		if (static_cast<std::size_t>(end_ - cur_) < size) {
+			chunks_.emplace_back(new std::byte[chunk_size]);
+			cur_ = chunks_.back().get(), end_ = cur_ + chunk_size;
+		}
+		void *ptr = cur_;
+		cur_ += size;
+		return ptr;
+	}
+
+	void do_deallocate(void *ptr, std::size_t bytes,
+					   std::size_t align) override {
+		if (bytes > max_small or align > granularity)
+			return std::pmr::new_delete_resource()->deallocate(ptr, bytes,
+															   align);
+
+		std::size_t cls = std::max<std::size_t>(
+			1, (bytes + granularity - 1) / granularity);
+		*static_cast<void **>(ptr) = free_[cls];
+		free_[cls] = ptr;
+	}
+
+	bool do_is_equal(const std::pmr::memory_resource &other) const
+		noexcept override {
+		return this == &other;
+	}
+
+	// Frees all chunks. Only valid if no block is in use.
+	void release() {
+		chunks_.clear();
+		cur_ = end_ = nullptr;
+		std::fill(std::begin(free_), std::end(free_), nullptr);
+	}
+};
+
+inline scratch_arena_internal &scratch_arena_of_thread_internal() {
+	thread_local scratch_arena_internal arena;
+	return arena;
+}
+
+inline std::pmr::memory_resource *scratch_resource_internal() {
+	return &scratch_arena_of_thread_internal();
+}
+
+// Marks a generation using the scratch arena. When the outermost generation
+// ends, no block is in use, so the arena is trimmed if it grew too large.
+struct scratch_scope_internal {
+	scratch_scope_internal() { ++scratch_arena_of_thread_internal().depth_; }
+	~scratch_scope_internal() {
+		scratch_arena_internal &arena = scratch_arena_of_thread_internal();
+		if (--arena.depth_ == 0 and arena.chunks_.size() * arena.chunk_size >
+										 arena.max_kept)
+			arena.release();
+	}
+};
+
+/*
+ * Sorted subsets.
+ */
+
+// Calls `select(x)` for every x of a uniformly random k-subset of [0, n), in
+// increasing order, with Vitter's Method D, computing with reals of type R.
+// Each step draws how many values to skip; if k is a large fraction of n,
+// Method A is used.
+template <typename R, typename F>
+void sorted_subset_real_internal(unsigned long long n, unsigned long long k,
+								 F &select) {
+	auto uniform = [] { return next<R>(0, 1); };
+	unsigned long long cur = 0; // Smallest value not skipped.
+
+	// Method D, while k < n / 13.
+	R k_real = k, n_real = n, k_inv = 1 / k_real;
+	R v_prime = std::exp(std::log(uniform()) * k_inv);
+	unsigned long long q1 = n - k + 1;
+	R q1_real = q1;
+	while (k > 1 and 13 * k < n) {
+		R k_min1_inv = 1 / (k_real - 1), x;
+		unsigned long long skip;
+		for (;;) {
+			// Candidate skip, from the envelope distribution.
+			for (;;) {
+				x = n_real * (1 - v_prime);
+				skip = x;
+				if (skip < q1)
+					break;
+				v_prime = std::exp(std::log(uniform()) * k_inv);
+			}
+			R u = uniform();
+			R neg_skip = -static_cast<R>(skip);
+			R y1 = std::exp(std::log(u * n_real / q1_real) * k_min1_inv);
+			v_prime = y1 * (1 - x / n_real) * (q1_real / (neg_skip + q1_real));
+			if (v_prime <= 1)
+				break; // Quick acceptance.
+
+			// Exact acceptance test.
+			R y2 = 1, top = n_real - 1, bottom;
+			unsigned long long limit;
+			if (k - 1 > skip)
+				bottom = n_real - k_real, limit = n - skip;
+			else
+				bottom = n_real - 1 + neg_skip, limit = q1;
+			for (unsigned long long t = n - 1; t >= limit; --t)
+				y2 = y2 * top / bottom, top -= 1, bottom -= 1;
+			if (n_real / (n_real - x) >=
+				y1 * std::exp(std::log(y2) * k_min1_inv)) {
+				v_prime = std::exp(std::log(uniform()) * k_min1_inv);
+				break;
+			}
+			v_prime = std::exp(std::log(uniform()) * k_inv);
+		}
+		cur += skip;
+		select(cur++);
+		n -= skip + 1, n_real = n;
+		--k, k_real = k, k_inv = k_min1_inv;
+		q1 -= skip, q1_real = q1;
+	}
+	if (k == 1) {
+		cur += static_cast<unsigned long long>(n_real * v_prime);
+		select(cur);
+		return;
+	}
+
+	// Method A.
+	R top = n - k;
+	n_real = n;
+	for (; k >= 2; --k) {
+		R v = uniform(), quot = top / n_real;
+		while (quot > v) {
+			++cur, top -= 1, n_real -= 1;
+			quot = quot * top / n_real;
+		}
+		select(cur++);
+		n_real -= 1;
+	}
+	cur += static_cast<unsigned long long>(n_real * uniform());
+	select(cur);
+}
+
+// Same as above, in O(k) expected time. Doubles are exact enough, and much
+// faster than long doubles, if n < 2^53.
+template <typename F>
+void vitter_subset_internal(unsigned long long n, unsigned long long k,
+							F &select) {
+	if (k == 0)
+		return;
+	if (n < (1ULL << 53))
+		sorted_subset_real_internal<double>(n, k, select);
+	else
+		sorted_subset_real_internal<long double>(n, k, select);
+}
+
+// Calls `select(x)` for every x of a uniformly random k-subset of [0, n), in
+// increasing order, in O(k) expected time and O(k / 64) memory.
+// [0, n) is split in chunks with about 64 values of the subset each. The
+// number of values in each chunk is drawn as for a subset with every value
+// taken independently with probability k/n, and then random values are removed
+// from (or added to) it until it has size k. This does not depend on the order
+// of the values, so the subset is still uniform, and each chunk is drawn
+// independently given its number of values.
+template <typename F>
+void sorted_subset_internal(unsigned long long n, unsigned long long k,
+							F select) {
+	tgen_ensure(k <= n, "subset size must be valid");
+	if (k < 4096)
+		return vitter_subset_internal(n, k, select);
+
+	scratch_scope_internal scratch;
+	std::pmr::memory_resource *res = scratch_resource_internal();
+	unsigned long long chunk = 64;
+	while (chunk < 64.0L * n / k)
+		chunk *= 2;
+	unsigned long long chunks = (n - 1) / chunk + 1;
+	auto chunk_size = [&](unsigned long long i) {
+		return i + 1 < chunks ? chunk : n - i * chunk;
+	};
+
+	double p = static_cast<long double>(k) / n;
+	std::binomial_distribution<unsigned long long> full(chunk, p),
+		last(chunk_size(chunks - 1), p);
+	std::pmr::vector<unsigned long long> count(chunks, res);
+	unsigned long long total = 0;
+	for (unsigned long long i = 0; i < chunks; ++i)
+		total += count[i] = (i + 1 < chunks ? full : last)(rng_internal());
+
+	// Ranks of the values to remove from the subset (or to add from its
+	// complement).
+	bool add = total < k;
+	auto pool = [&](unsigned long long i) {
+		return add ? chunk_size(i) - count[i] : count[i];
+	};
+	unsigned long long idx = 0, before = 0, in_chunk = pool(0);
+	auto fix = [&](unsigned long long rank) {
+		while (before + in_chunk <= rank)
+			before += in_chunk, in_chunk = pool(++idx);
+		add ? ++count[idx] : --count[idx];
+	};
+	vitter_subset_internal(add ? n - total : total,
+						   add ? k - total : total - k, fix);
+
+	// Draws the values of each chunk. Dense chunks mark the values (or the
+	// values not taken, if fewer) in a table. Sparse chunks draw values, sort
+	// them with a bucket sort and draw again the repeated ones.
+	std::pmr::vector<unsigned long long> draws(res), sorted(res), start(res);
+	for (unsigned long long i = 0; i < chunks; ++i) {
+		unsigned long long base = i * chunk, size = chunk_size(i);
+		if (size <= 4096 and size <= 32 * count[i]) {
+			std::array<bool, 4096> marked;
+			std::fill(marked.begin(), marked.begin() + size, false);
+			bool complement = 2 * count[i] > size;
+			unsigned long long left = complement ? size - count[i] : count[i];
+			while (left > 0) {
+				unsigned long long x = next<unsigned long long>(0, size - 1);
+				if (!marked[x])
+					marked[x] = true, --left;
+			}
+			for (unsigned long long x = 0; x < size; ++x)
+				if (marked[x] != complement)
+					select(base + x);
+			continue;
+		}
+
+		draws.clear();
+		while (draws.size() < count[i]) {
+			while (draws.size() < count[i])
+				draws.push_back(next<unsigned long long>(0, size - 1));
+			std::size_t m = draws.size();
+			double scale = static_cast<double>(m) / size;
+			auto bucket = [&](unsigned long long x) {
+				return std::min<std::size_t>(x * scale, m - 1);
+			};
+			start.assign(m + 1, 0);
+			sorted.resize(m);
+			for (unsigned long long x : draws)
+				++start[bucket(x) + 1];
+			for (std::size_t b = 0; b < m; ++b)
+				start[b + 1] += start[b];
+			for (unsigned long long x : draws)
+				sorted[start[bucket(x)]++] = x;
+			// Buckets have expected size 1, so this is linear.
+			for (std::size_t j = 1; j < m; ++j)
+				for (std::size_t t = j; t > 0 and sorted[t - 1] > sorted[t];
+					 --t)
+					std::swap(sorted[t - 1], sorted[t]);
+			draws.assign(sorted.begin(),
+						 std::unique(sorted.begin(), sorted.end()));
+		}
+		for (unsigned long long x : draws)
+			select(base + x);
+	}
+}
+
+/*
+ * Parallel work.
+ */
+
+// Number of threads given with `--tgen-threads`, or 0.
+inline int thread_count_opt_internal = 0;
+
+// Number of threads for parallel work.
+inline int thread_count_internal() {
+	static int hardware = std::max(1u, std::thread::hardware_concurrency());
+	return thread_count_opt_internal > 0 ? thread_count_opt_internal
+										 : hardware;
+}
+
+// Calls `task(i)` for every i in [0, count), each on its own thread (the last
+// one on the calling thread).
+template <typename F> void parallel_internal(int count, F task) {
+	std::vector<std::thread> threads;
+	for (int i = 0; i + 1 < count; ++i)
+		threads.emplace_back(task, i);
+	task(count - 1);
+	for (std::thread &thread : threads)
+		thread.join();
+}
+
+// Values per block of parallel fills.
+inline constexpr long long fill_block_internal = 1 << 16;
+
+// Draws the key of a parallel fill.
+inline uint64_t fill_key_internal() {
+	uint64_t high = rng_internal()();
+	return high << 32 | rng_internal()();
+}
+
+// Makes the calling thread draw from a Philox stream, for work whose random
+// draws must not depend on the thread that does it.
+inline void seed_stream_internal(uint64_t key, uint64_t stream) {
+	philox_seed_internal seq{key, stream};
+	rng_stream_internal.emplace();
+	rng_stream_internal->seed(seq);
+}
+
+// Restores the random state of the calling thread on destruction, for work
+// that seeds it with streams.
+struct rng_guard_internal {
+	std::optional<std::mt19937> saved_ = rng_stream_internal;
+	~rng_guard_internal() { rng_stream_internal = saved_; }
+};
+
+// Calls `fill(engine, first, last)` for the blocks [first, last) of the
+// indices in [begin, end), on several threads. `begin` is a multiple of the
+// block size, and the engine of a block is the Philox stream of its index, so
+// that the values do not depend on the number of threads.
+template <typename F>
+void parallel_fill_internal(uint64_t key, long long begin, long long end,
+							F fill) {
+	long long first_block = begin / fill_block_internal;
+	long long blocks = (end - begin + fill_block_internal - 1) /
+					   fill_block_internal;
+	int threads = std::min<long long>(thread_count_internal(), blocks);
+	parallel_internal(threads, [&](int t) {
+		for (long long b = t; b < blocks; b += threads) {
+			philox_internal engine(key, first_block + b);
+			long long first = begin + b * fill_block_internal;
+			fill(engine, first, std::min(end, first + fill_block_internal));
+		}
+	});
+}
+
+// Number of threads for n values, with at least 2^16 values each.
+inline int work_threads_internal(std::size_t n) {
+	return std::max<std::size_t>(
+		1, std::min<std::size_t>(thread_count_internal(), n >> 16));
+}
+
+// Sorts integral values with an LSD radix sort, on digits of 11 bits. The
+// sign bit of signed values is flipped, so that they sort as unsigned. Each
+// pass counts and scatters blocks of the values on different threads, and
+// passes on digits that all values share are skipped.
+template <typename T> void radix_sort_internal(std::vector<T> &vec) {
+	using U = std::make_unsigned_t<T>;
+	constexpr int width = 8 * sizeof(T), bits = std::min(11, width),
+				  radix = 1 << bits;
+	constexpr U flip = std::is_signed_v<T> ? U(1) << (width - 1) : 0;
+	std::size_t n = vec.size();
+	int threads = work_threads_internal(n);
+	auto block = [&](int t) { return n * t / threads; };
+
+	scratch_scope_internal scratch;
+	std::pmr::memory_resource *res = scratch_resource_internal();
+	std::pmr::vector<T> buf(n, res);
+	std::pmr::vector<std::size_t> count(radix * threads, res);
+	T *from = vec.data(), *to = buf.data();
+	for (int shift = 0; shift < width; shift += bits) {
+		auto digit = [&](T val) {
+			return (static_cast<U>(val) ^ flip) >> shift & (radix - 1);
+		};
+		std::fill(count.begin(), count.end(), 0);
+		parallel_internal(threads, [&](int t) {
+			std::size_t *cnt = &count[radix * t];
+			for (std::size_t i = block(t); i < block(t + 1); ++i)
+				++cnt[digit(from[i])];
+		});
+
+		// Position of the values of each digit of each block.
+		std::size_t pos = 0;
+		bool shared = false;
+		for (int d = 0; d < radix; ++d) {
+			std::size_t start = pos;
+			for (int t = 0; t < threads; ++t)
+				pos += std::exchange(count[radix * t + d], pos);
+			shared |= pos - start == n;
+		}
+		if (shared)
+			continue;
+
+		parallel_internal(threads, [&](int t) {
+			std::size_t *cnt = &count[radix * t];
+			for (std::size_t i = block(t); i < block(t + 1); ++i)
+				to[cnt[digit(from[i])]++] = from[i];
+		});
+		std::swap(from, to);
+	}
+	if (from != vec.data())
+		std::copy(from, from + n, vec.data());
+}
+
+// Sorts values in non-decreasing order. Integral values are radix sorted,
+// other values are sorted in blocks on different threads, that are then
+// merged in pairs.
+template <typename T> void sort_internal(std::vector<T> &vec) {
+	if constexpr (std::is_integral_v<T> and !std::is_same_v<T, bool>)
+		if (vec.size() >= (1 << 12))
+			return radix_sort_internal(vec);
+
+	int threads = work_threads_internal(vec.size());
+	auto block = [&](int t) {
+		return vec.begin() + vec.size() * std::min(t, threads) / threads;
+	};
+	parallel_internal(threads,
+					  [&](int t) { std::sort(block(t), block(t + 1)); });
+	for (int width = 1; width < threads; width *= 2)
+		parallel_internal((threads + 2 * width - 1) / (2 * width), [&](int i) {
+			int t = 2 * width * i;
+			std::inplace_merge(block(t), block(t + width),
+							   block(t + 2 * width));
+		});
+}
+
 // Base struct for generators.
 template <typename GEN> struct gen_base {
-	// Calls the generator until predicate is true.
+	// Calls the generator until predicate is true. Candidate i is generated
+	// from its own random stream, and the accepted candidate of lowest index is
+	// returned.
 	template <typename PRED, typename... Args>
 	auto gen_until(PRED predicate, int max_tries, Args &&...args) {
-		for (int i = 0; i < max_tries; ++i) {
-			auto inst =
-				static_cast<GEN *>(this)->gen(std::forward<Args>(args)...);
-
-			if (predicate(inst))
-				return inst;
-		}
-
-		throw error_internal("could not generate instance matching predicate");
+		return gen_until_internal(1, predicate, max_tries, args...);
 	}
 	template <typename PRED, typename T, typename... Args>
 	auto gen_until(PRED predicate, int max_tries, std::initializer_list<T> il,
@@ -141,6 +954,85 @@ template <typename GEN> struct gen_base {
 						 std::forward<Args>(args)...);
 	}
 
+	// Same as `gen_until`, with the same result, but candidates after the
+	// first one are tried on several threads (each with a copy of the
+	// generator). The predicate is called concurrently, so it must be safe to
+	// call from several threads.
+	template <typename PRED, typename... Args>
+	auto gen_until_parallel(PRED predicate, int max_tries, Args &&...args) {
+		return gen_until_internal(thread_count_internal(), predicate,
+								  max_tries, args...);
+	}
+	template <typename PRED, typename T, typename... Args>
+	auto gen_until_parallel(PRED predicate, int max_tries,
+							std::initializer_list<T> il, Args &&...args) {
+		return gen_until_parallel(predicate, max_tries, std::vector<T>(il),
+								  std::forward<Args>(args)...);
+	}
+
+	// Tries the candidates of `gen_until` on up to `threads` threads.
+	template <typename PRED, typename... Args>
+	auto gen_until_internal(int threads, PRED &predicate, int max_tries,
+							Args &...args) {
+		tgen_trace_internal("gen_until");
+		using instance_t = decltype(static_cast<GEN *>(this)->gen(args...));
+		uint64_t key = fill_key_internal();
+
+		rng_guard_internal guard;
+
+		std::mutex mutex;
+		std::atomic<int> next_try = 0;
+		int found = max_tries; // Lowest candidate that passed or threw.
+		std::optional<instance_t> result;
+		std::exception_ptr error;
+		auto try_candidate = [&](GEN &gen, int i) {
+			seed_stream_internal(key, i);
+			try {
+				auto inst = gen.gen(args...);
+				if (!predicate(inst))
+					return;
+				std::lock_guard lock(mutex);
+				if (i < found)
+					found = i, result.emplace(std::move(inst)), error = nullptr;
+			} catch (...) {
+				std::lock_guard lock(mutex);
+				if (i < found)
+					found = i, result.reset(), error = std::current_exception();
+			}
+		};
+		auto lowest_found = [&] {
+			std::lock_guard lock(mutex);
+			return found;
+		};
+
+		// The first candidate is tried on the calling thread, since predicates
+		// often pass at once.
+		GEN &self = *static_cast<GEN *>(this);
+		if (max_tries > 0)
+			try_candidate(self, next_try++);
+		if (threads <= 1) {
+			for (int i; (i = next_try++) < lowest_found();)
+				try_candidate(self, i);
+		} else if (lowest_found() == max_tries and max_tries > 1) {
+			parallel_internal(std::min(threads, max_tries - 1), [&](int) {
+				GEN gen = self;
+				for (int i; (i = next_try++) < lowest_found();)
+					try_candidate(gen, i);
+			});
+		}
+		// Candidates after the accepted one were only speculative.
+		tgen_stats_internal(
+			stats::gen_until_attempts += std::min(found + 1, max_tries);
+			stats::gen_until_accepted += result.has_value();)
+
+		if (error)
+			std::rethrow_exception(error);
+		if (!result)
+			throw error_internal(
+				"could not generate instance matching predicate");
+		return std::move(*result);
+	}
+
 	// Nice error for `std::cout << generator`.
 	friend std::ostream &operator<<(std::ostream &out, const gen_base &) {
 		static_assert(
@@ -150,63 +1042,278 @@ template <typename GEN> struct gen_base {
 	}
 };
 
-/************
- *          *
- *   OPTS   *
- *          *
- ************/
+/*************
+ *           *
+ *   CACHE   *
+ *           *
+ *************/
 
 /*
- * Opts - options given to the generator.
+ * On-disk cache of generated outputs.
  *
- * Incompatible with testlib.
- *
- * Opts are a list of either positional or named options.
- *
- * Named options is given in one of the following formats:
- * 1) -keyname=value or --keyname=value (ex. -n=10   , --test-count=20)
- * 2) -keyname value or --keyname value (ex. -n 10   , --test-count 20)
+ * Opt-in by setting the environment variable `TGEN_CACHE_DIR`. The output of
+ * a generator only depends on the generator itself and on argv, so everything
+ * written to `std::cout` is stored under a key hashed from the binary (or from
+ * the file in `TGEN_CACHE_SOURCE`, if set), argv and the tgen version. On a
+ * hit, the stored output is copied to stdout and the program exits without
+ * generating. An entry is only stored when the generator calls `commit_cache`,
+ * so runs that fail or exit early are never replayed.
  *
- * Positional options are number from 0 sequentially.
- * For example, for "10 -n=20 str" positional option 1 is the string "str".
+ * `TGEN_CACHE_SIZE` bounds the size of the cache in bytes (default 1 GiB).
+ * Least recently used entries are evicted first.
  */
 
-inline std::vector<std::string>
-	pos_opts_internal; // Dictionary containing the positional parsed opts.
-inline std::map<std::string, std::string>
-	named_opts_internal; // Global dictionary the named parsed opts.
+// FNV-1a hash of [data, data + size), starting from hash.
+inline uint64_t fnv1a_internal(uint64_t hash, const char *data,
+							   std::size_t size) {
+	for (std::size_t i = 0; i < size; ++i) {
+		hash ^= static_cast<unsigned char>(data[i]);
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
 
-// Returns true if there is an opt at a given index.
-inline bool has_opt(std::size_t index) {
-	return 0 <= index and index < pos_opts_internal.size();
+// Returns the cache key for the given argv, or nothing if the generator could
+// not be read.
+inline std::optional<std::string> cache_key_internal(int argc, char **argv) {
+	uint64_t hash = 14695981039346656037ULL;
+	hash = fnv1a_internal(hash, TGEN_VERSION, sizeof(TGEN_VERSION));
+
+	// Hashes the generator (or its source).
+	const char *source = std::getenv("TGEN_CACHE_SOURCE");
+	std::ifstream file(source ? source : "/proc/self/exe", std::ios::binary);
+	if (!file and argc > 0 and !source)
+		file.open(argv[0], std::ios::binary);
+	if (!file)
+		return std::nullopt;
+	std::vector<char> buffer(1 << 16);
+	while (file.read(buffer.data(), buffer.size()) or file.gcount() > 0)
+		hash = fnv1a_internal(hash, buffer.data(), file.gcount());
+
+	// Hashes argv as in `set_seed_internal`, ignoring the executable name.
+	for (int i = 1; i < argc; ++i) {
+		std::string arg(argv[i]);
+		std::size_t size = arg.size();
+		hash = fnv1a_internal(hash, reinterpret_cast<const char *>(&size),
+							  sizeof(size));
+		hash = fnv1a_internal(hash, arg.data(), arg.size());
+	}
+
+	static const char digits[] = "0123456789abcdef";
+	std::string key;
+	for (int shift = 60; shift >= 0; shift -= 4)
+		key += digits[(hash >> shift) & 15];
+	return key;
 }
 
-// Returns true if there is an opt with a given key.
-inline bool has_opt(const std::string &key) {
-	return named_opts_internal.count(key) != 0;
+// If name is the name of a committed entry, i.e., a key.
+inline bool cache_entry_name_internal(const std::string &name) {
+	return name.size() == 16 and
+		   std::all_of(name.begin(), name.end(), [](char c) {
+			   return ('0' <= c and c <= '9') or ('a' <= c and c <= 'f');
+		   });
 }
 
-template <typename T> T get_opt_internal(const std::string &value) {
-	try {
-		if constexpr (std::is_same_v<T, bool>) {
-			if (value == "true" or value == "1")
-				return true;
-			if (value == "false" or value == "0")
-				return false;
-		} else if constexpr (std::is_integral_v<T>) {
-			if constexpr (std::is_unsigned_v<T>)
-				return static_cast<T>(std::stoull(value));
-			else
-				return static_cast<T>(std::stoll(value));
-		} else if constexpr (std::is_floating_point_v<T>)
-			return static_cast<T>(std::stold(value));
-		else
-			return value; // default: std::string
-	} catch (...) {
+// Removes least recently used entries of dir until their total size is at most
+// max_bytes. Other files (entries being written, or not from the cache) are
+// left untouched.
+inline void cache_evict_internal(const std::filesystem::path &dir,
+								 uintmax_t max_bytes) {
+	namespace fs = std::filesystem;
+	std::error_code ec;
+	std::vector<std::pair<fs::file_time_type, fs::path>> entries;
+	uintmax_t total = 0;
+	for (const auto &entry : fs::directory_iterator(dir, ec)) {
+		if (!entry.is_regular_file(ec) or
+			!cache_entry_name_internal(entry.path().filename().string()))
+			continue;
+		total += entry.file_size(ec);
+		entries.emplace_back(entry.last_write_time(ec), entry.path());
+	}
+	std::sort(entries.begin(), entries.end());
+	for (const auto &[time, path] : entries) {
+		if (total <= max_bytes)
+			break;
+		uintmax_t size = fs::file_size(path, ec);
+		if (fs::remove(path, ec))
+			total -= size;
 	}
-
-	throw error_internal("invalid value `" + value + "` for type " +
-						 typeid(T).name());
+}
+
+// Stream buffer that writes both to the original `std::cout` buffer and to
+// the cache entry being created.
+struct cache_tee_buf_internal : std::streambuf {
+	std::streambuf *out_ = nullptr; // Original buffer.
+	std::ofstream file_;			// Cache entry.
+	char buffer_[1 << 13];
+
+	cache_tee_buf_internal() { setp(buffer_, buffer_ + sizeof(buffer_)); }
+
+	bool flush_buffer() {
+		std::streamsize size = pptr() - pbase();
+		if (size > 0) {
+			if (out_->sputn(pbase(), size) != size)
+				return false;
+			file_.write(pbase(), size);
+		}
+		setp(buffer_, buffer_ + sizeof(buffer_));
+		return true;
+	}
+
+	int overflow(int c) override {
+		if (!flush_buffer())
+			return traits_type::eof();
+		if (c != traits_type::eof()) {
+			*pptr() = traits_type::to_char_type(c);
+			pbump(1);
+		}
+		return traits_type::not_eof(c);
+	}
+
+	int sync() override {
+		if (!flush_buffer())
+			return -1;
+		return out_->pubsync();
+	}
+};
+
+inline cache_tee_buf_internal cache_buf_internal;
+inline std::filesystem::path cache_tmp_path_internal, cache_entry_path_internal;
+inline uintmax_t cache_max_bytes_internal;
+
+// Stops recording `std::cout`. If commit, stores the entry written so far.
+// Otherwise, discards it.
+inline void cache_stop_internal(bool commit) {
+	if (!cache_buf_internal.file_.is_open())
+		return;
+	std::cout.flush();
+	std::cout.rdbuf(cache_buf_internal.out_);
+	cache_buf_internal.file_.close();
+
+	std::error_code ec;
+	if (!commit or cache_buf_internal.file_.fail()) {
+		std::filesystem::remove(cache_tmp_path_internal, ec);
+		return;
+	}
+	std::filesystem::rename(cache_tmp_path_internal, cache_entry_path_internal,
+							ec);
+	cache_evict_internal(cache_entry_path_internal.parent_path(),
+						 cache_max_bytes_internal);
+}
+
+// Stores everything written to `std::cout` so far as the cache entry of this
+// run. Must be called after all output, at the end of a successful run.
+// Without it, the output is not cached.
+inline void commit_cache() { cache_stop_internal(true); }
+
+// Parses the size of the cache from `TGEN_CACHE_SIZE`, in bytes.
+inline uintmax_t cache_size_internal(const char *size) {
+	if (!size)
+		return 1ULL << 30;
+	uintmax_t bytes = 0;
+	const char *last = size + std::strlen(size);
+	auto [ptr, ec] = std::from_chars(size, last, bytes);
+	tgen_ensure(ec == std::errc() and ptr == last and ptr != size,
+				"TGEN_CACHE_SIZE must be a non-negative integer");
+	return bytes;
+}
+
+// Replays the cached output and exits on a hit. Otherwise, starts recording
+// `std::cout` into the cache.
+inline void cache_internal(int argc, char **argv) {
+	namespace fs = std::filesystem;
+	const char *dir = std::getenv("TGEN_CACHE_DIR");
+	if (!dir or cache_buf_internal.out_)
+		return;
+	cache_max_bytes_internal =
+		cache_size_internal(std::getenv("TGEN_CACHE_SIZE"));
+
+	std::optional<std::string> key = cache_key_internal(argc, argv);
+	std::error_code ec;
+	if (!key or (fs::create_directories(dir, ec), ec))
+		return;
+	fs::path entry = fs::path(dir) / *key;
+
+	if (fs::is_regular_file(entry, ec)) {
+		std::ifstream file(entry, std::ios::binary);
+		if (file) {
+			// Touches entry, for LRU.
+			fs::last_write_time(entry, fs::file_time_type::clock::now(), ec);
+			if (fs::file_size(entry, ec) > 0)
+				std::cout << file.rdbuf();
+			std::cout.flush();
+			std::exit(0);
+		}
+	}
+
+	cache_entry_path_internal = entry;
+	std::string suffix = ".tmp" + std::to_string(std::random_device()());
+	cache_tmp_path_internal = fs::path(dir) / (*key + suffix);
+	cache_buf_internal.file_.open(cache_tmp_path_internal, std::ios::binary);
+	if (!cache_buf_internal.file_)
+		return;
+	cache_buf_internal.out_ = std::cout.rdbuf(&cache_buf_internal);
+	// Discards the entry if the run exits without `commit_cache`.
+	std::atexit([] { cache_stop_internal(false); });
+}
+
+/************
+ *          *
+ *   OPTS   *
+ *          *
+ ************/
+
+/*
+ * Opts - options given to the generator.
+ *
+ * Incompatible with testlib.
+ *
+ * Opts are a list of either positional or named options.
+ *
+ * Named options is given in one of the following formats:
+ * 1) -keyname=value or --keyname=value (ex. -n=10   , --test-count=20)
+ * 2) -keyname value or --keyname value (ex. -n 10   , --test-count 20)
+ *
+ * Positional options are number from 0 sequentially.
+ * For example, for "10 -n=20 str" positional option 1 is the string "str".
+ */
+
+inline std::vector<std::string>
+	pos_opts_internal; // Dictionary containing the positional parsed opts.
+inline std::map<std::string, std::string>
+	named_opts_internal; // Global dictionary the named parsed opts.
+
+// Returns true if there is an opt at a given index.
+inline bool has_opt(std::size_t index) {
+	return 0 <= index and index < pos_opts_internal.size();
+}
+
+// Returns true if there is an opt with a given key.
+inline bool has_opt(const std::string &key) {
+	return named_opts_internal.count(key) != 0;
+}
+
+template <typename T> T get_opt_internal(const std::string &value) {
+	try {
+		if constexpr (std::is_same_v<T, bool>) {
+			if (value == "true" or value == "1")
+				return true;
+			if (value == "false" or value == "0")
+				return false;
+		} else if constexpr (std::is_integral_v<T>) {
+			if constexpr (std::is_unsigned_v<T>)
+				return static_cast<T>(std::stoull(value));
+			else
+				return static_cast<T>(std::stoll(value));
+		} else if constexpr (std::is_floating_point_v<T>)
+			return static_cast<T>(std::stold(value));
+		else
+			return value; // default: std::string
+	} catch (...) {
+	}
+
+	throw error_internal("invalid value `" + value + "` for type " +
+						 typeid(T).name());
 }
 
 // Returns the parsed opt by a given key. If no opts with the given key are
@@ -303,11 +1410,79 @@ inline void set_seed_internal(int argc, char **argv) {
 		}
 	}
 	std::seed_seq seq(seed.begin(), seed.end());
-	rng_internal.seed(seq);
+	rng_global_internal.seed(seq);
+	rng_stream_internal.reset();
+}
+
+// Prints the stats at exit, if `--tgen-stats` was given.
+inline void stats_exit_internal() {
+#ifdef TGEN_STATS
+	stats::dump(std::cerr);
+#else
+	std::cerr << "tgen: stats are compiled out, define `TGEN_STATS` to enable "
+				 "them"
+			  << std::endl;
+#endif
+}
+
+inline std::string trace_path_internal; // File of `--tgen-trace`.
+
+// Writes the trace at exit, if `--tgen-trace` was given.
+inline void trace_exit_internal() {
+#ifdef TGEN_TRACE
+	std::ofstream file(trace_path_internal);
+	trace_write_internal(file);
+#else
+	std::cerr << "tgen: tracing is compiled out, define `TGEN_TRACE` to enable "
+				 "it"
+			  << std::endl;
+#endif
 }
 
-// Registers generator by initializing rnd and parsing opts.
+// Applies and removes the opts reserved by tgen (starting with `--tgen-`), so
+// that they do not change the seed nor the opts. Returns the remaining argv,
+// ending with a null pointer.
+inline std::vector<char *> reserved_opts_internal(int argc, char **argv) {
+	thread_count_opt_internal = 0;
+	std::vector<char *> args;
+	for (int i = 0; i < argc; ++i) {
+		std::string arg(argv[i]);
+		if (i == 0 or arg.rfind("--tgen-", 0) != 0) {
+			args.push_back(argv[i]);
+			continue;
+		}
+
+		if (arg == "--tgen-stats") {
+			static bool registered = false;
+			if (!registered)
+				std::atexit(stats_exit_internal);
+			registered = true;
+		} else if (arg.rfind("--tgen-threads=", 0) == 0) {
+			std::string value = arg.substr(arg.find('=') + 1);
+			thread_count_opt_internal = std::atoi(value.c_str());
+			tgen_ensure(thread_count_opt_internal > 0,
+						"expected positive number of threads in opt (" + arg +
+							")");
+		} else if (arg.rfind("--tgen-trace=", 0) == 0) {
+			if (trace_path_internal.empty())
+				std::atexit(trace_exit_internal);
+			trace_path_internal = arg.substr(arg.find('=') + 1);
+			tgen_ensure(!trace_path_internal.empty(),
+						"expected non-empty file in opt (" + arg + ")");
+		} else
+			throw error_internal("unknown tgen opt (" + arg + ")");
+	}
+	args.push_back(nullptr);
+	return args;
+}
+
+// Registers generator by initializing rnd and parsing opts. If the cache is
+// enabled and has the output for this argv, prints it and exits.
 inline void register_gen(int argc, char **argv) {
+	std::vector<char *> args = reserved_opts_internal(argc, argv);
+	argc = args.size() - 1, argv = args.data();
+
+	cache_internal(argc, argv);
 	set_seed_internal(argc, argv);
 
 	pos_opts_internal.clear();
@@ -315,6 +1490,416 @@ inline void register_gen(int argc, char **argv) {
 	parse_opts_internal(argc, argv);
 }
 
+/***********
+ *         *
+ *   I/O   *
+ *         *
+ ***********/
+
+// Maps the file at path in memory (or reads it, without mmap). Returns its
+// bytes, aligned to 8, and its size.
+inline std::pair<std::shared_ptr<const unsigned char>, std::size_t>
+map_file_internal(const std::string &path) {
+#ifdef TGEN_MMAP_INTERNAL
+	int fd = ::open(path.c_str(), O_RDONLY);
+	struct stat st;
+	if (fd < 0 or ::fstat(fd, &st) != 0) {
+		if (fd >= 0)
+			::close(fd);
+		throw error_internal("could not open `" + path + "`");
+	}
+	std::size_t size = st.st_size;
+	void *ptr = size > 0
+					? ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0)
+					: nullptr;
+	::close(fd);
+	if (ptr == MAP_FAILED)
+		throw error_internal("could not map `" + path + "`");
+	return {std::shared_ptr<const unsigned char>(
+				static_cast<const unsigned char *>(ptr),
+				[size](const unsigned char *bytes) {
+					if (size > 0)
+						::munmap(const_cast<unsigned char *>(bytes), size);
+				}),
+			size};
+#else
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file)
+		throw error_internal("could not open `" + path + "`");
+	std::size_t size = file.tellg();
+	std::shared_ptr<uint64_t[]> words(new uint64_t[size / 8 + 1]);
+	file.seekg(0).read(reinterpret_cast<char *>(words.get()), size);
+	return {std::shared_ptr<const unsigned char>(
+				words, reinterpret_cast<const unsigned char *>(words.get())),
+			size};
+#endif
+}
+
+/*
+ * Text reader.
+ *
+ * Parses the whitespace-separated values of a file mapped in memory (for
+ * example, a test printed by tgen) with `std::from_chars`, to load it back
+ * into instances.
+ */
+
+struct reader {
+	std::string path_;							// Path of the file.
+	std::shared_ptr<const unsigned char> file_; // Bytes of the file.
+	const char *at_, *end_;						// Unread bytes.
+
+	// Opens the file at path.
+	reader(const std::string &path) : path_(path) {
+		std::size_t size;
+		std::tie(file_, size) = map_file_internal(path);
+		at_ = reinterpret_cast<const char *>(file_.get());
+		end_ = at_ + size;
+	}
+
+	static bool is_space_internal(char c) {
+		return static_cast<unsigned char>(c) <= ' ';
+	}
+
+	// Skips whitespace. Returns if there are unread values.
+	bool skip_internal() {
+		while (at_ != end_ and is_space_internal(*at_))
+			++at_;
+		return at_ != end_;
+	}
+
+	std::runtime_error error_at_internal(const std::string &msg) const {
+		return error_internal(
+			"could not read `" + path_ + "` at byte " +
+			std::to_string(at_ - reinterpret_cast<const char *>(file_.get())) +
+			": " + msg);
+	}
+
+	// Parses an integer of at most 19 digits at `at_`, 8 digits at a time
+	// (Lemire, "Fast numeric parsing"). Returns false, without reading, if it
+	// could not, so `std::from_chars` finds the error.
+	template <typename T> bool parse_integer_internal(T &value) {
+		const char *ptr = at_;
+		bool negative = std::is_signed_v<T> and *ptr == '-';
+		ptr += negative;
+		const char *digits = ptr;
+		uint64_t abs = 0;
+		while (end_ - ptr >= 8) {
+			uint64_t chunk;
+			std::memcpy(&chunk, ptr, 8);
+			if (((chunk & 0xF0F0F0F0F0F0F0F0ULL) |
+				 (((chunk + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >>
+				  4)) != 0x3333333333333333ULL)
+				break;
+			chunk -= 0x3030303030303030ULL;
+			chunk = chunk * 10 + (chunk >> 8);
+			chunk = ((chunk & 0x000000FF000000FFULL) *
+						 (100 + (1000000ULL << 32)) +
+					 ((chunk >> 16) & 0x000000FF000000FFULL) *
+						 (1 + (10000ULL << 32))) >>
+					32;
+			abs = abs * 100000000 + chunk;
+			ptr += 8;
+			if (ptr - digits > 16)
+				return false;
+		}
+		while (ptr != end_ and '0' <= *ptr and *ptr <= '9') {
+			abs = abs * 10 + (*ptr++ - '0');
+			if (ptr - digits > 19)
+				return false;
+		}
+		if (ptr == digits or (ptr != end_ and !is_space_internal(*ptr)))
+			return false;
+
+		using U = std::make_unsigned_t<T>;
+		uint64_t max = static_cast<U>(std::numeric_limits<T>::max());
+		if (abs > max + negative)
+			return false;
+		value = negative ? static_cast<T>(~abs + 1) : static_cast<T>(abs);
+		at_ = ptr;
+		return true;
+	}
+
+	// If all values were read.
+	bool eof() { return !skip_internal(); }
+
+	// Reads the next value.
+	template <typename T> T read() {
+		if (!skip_internal())
+			throw error_at_internal("expected a value, found end of file");
+		T value;
+		const char *token_end = at_;
+		if constexpr (std::is_integral_v<T> and !std::is_same_v<T, char> and
+					  !std::is_same_v<T, bool>)
+			if (parse_integer_internal(value))
+				return value;
+		if constexpr (std::is_arithmetic_v<T> and !std::is_same_v<T, char>) {
+			std::from_chars_result result = std::from_chars(at_, end_, value);
+			token_end = result.ptr;
+			if (result.ec != std::errc() or
+				(token_end != end_ and !is_space_internal(*token_end)))
+				throw error_at_internal("expected a value of type " +
+										std::string(typeid(T).name()));
+		} else {
+			while (token_end != end_ and !is_space_internal(*token_end))
+				++token_end;
+			if constexpr (std::is_same_v<T, char>) {
+				if (token_end - at_ != 1)
+					throw error_at_internal("expected a character");
+				value = *at_;
+			} else
+				value = T(at_, token_end);
+		}
+		at_ = token_end;
+		return value;
+	}
+
+	// Reads the next count values.
+	template <typename T> std::vector<T> read(std::size_t count) {
+		std::vector<T> vec(count);
+		for (T &value : vec)
+			value = read<T>();
+		return vec;
+	}
+};
+
+/*
+ * Text writer.
+ *
+ * Formats values with `std::to_chars` into a buffer, that is written to the
+ * stream in large chunks, for instances with millions of values.
+ */
+
+struct writer_internal {
+	static constexpr int capacity_internal = 1 << 16; // Bytes per write.
+	std::ostream &out_;								  // Stream.
+	char buffer_[capacity_internal + 32];			  // Unwritten bytes.
+	int used_ = 0;									  // Size of the buffer.
+
+	writer_internal(std::ostream &out) : out_(out) {}
+	~writer_internal() { flush(); }
+
+	void flush() {
+		out_.write(buffer_, used_);
+		used_ = 0;
+	}
+
+	void write(char c) {
+		buffer_[used_++] = c;
+		if (used_ >= capacity_internal)
+			flush();
+	}
+	void write(long long value) {
+		used_ = std::to_chars(buffer_ + used_, buffer_ + sizeof(buffer_), value)
+					.ptr -
+				buffer_;
+		if (used_ >= capacity_internal)
+			flush();
+	}
+};
+
+/*
+ * Binary instances.
+ *
+ * Compact format of instances, for harnesses that pass large tests between
+ * programs without formatting and parsing text. A file is a 16-byte header,
+ * the values, and an 8-byte checksum of the values. The header is "TGEN", the
+ * format version, the type of the values (0x10 if signed integral, 0x20 if
+ * floating point, plus their size in bytes), the flags (1 for `add_1`, 2 for
+ * varint values), a zero byte, and the number of values. Values are raw
+ * little-endian words, or (for integral values) zigzag LEB128 varints. Only
+ * little-endian hosts are supported.
+ */
+
+// Encoding of the values of a binary instance.
+enum class binary_encoding { raw, varint };
+
+inline constexpr char binary_magic_internal[4] = {'T', 'G', 'E', 'N'};
+inline constexpr int binary_header_internal = 16; // Bytes of the header.
+inline constexpr uint8_t binary_add_1_internal = 1, binary_varint_internal = 2;
+
+// Code of the type of the values in the header.
+template <typename T> constexpr uint8_t binary_type_internal() {
+	static_assert(std::is_arithmetic_v<T>, "binary values must be arithmetic");
+	if constexpr (std::is_floating_point_v<T>)
+		return 0x20 | sizeof(T);
+	else if constexpr (std::is_signed_v<T>)
+		return 0x10 | sizeof(T);
+	else
+		return sizeof(T);
+}
+
+// Checksum of [data, data + size), continuing from hash, with a multiplicative
+// hash of the 8-byte words. `size` is a multiple of 8, except at the end.
+inline uint64_t binary_checksum_internal(uint64_t hash,
+										 const unsigned char *data,
+										 std::size_t size) {
+	for (std::size_t i = 0; i < size; i += 8) {
+		uint64_t word = 0;
+		std::memcpy(&word, data + i, std::min<std::size_t>(8, size - i));
+		hash = (hash ^ word) * 0x9E3779B97F4A7C15ULL;
+		hash ^= hash >> 32;
+	}
+	return hash;
+}
+
+// If the instance has the `add_1_` flag.
+template <typename INST, typename = void>
+struct has_add_1_internal : std::false_type {};
+template <typename INST>
+struct has_add_1_internal<INST, std::void_t<decltype(INST::add_1_)>>
+	: std::true_type {};
+
+// Writes the instance in the binary format.
+template <typename INST>
+void write_binary(std::ostream &out, const INST &inst,
+				  binary_encoding encoding = binary_encoding::raw) {
+	using T = std::decay_t<decltype(inst[0])>;
+	bool varint = encoding == binary_encoding::varint;
+	tgen_ensure(std::is_integral_v<T> or !varint,
+				"varint values must be integral");
+	uint8_t flags = varint ? binary_varint_internal : 0;
+	if constexpr (has_add_1_internal<INST>::value)
+		if (inst.add_1_)
+			flags |= binary_add_1_internal;
+
+	char header[binary_header_internal] = {};
+	std::memcpy(header, binary_magic_internal, 4);
+	header[4] = 1, header[5] = binary_type_internal<T>(), header[6] = flags;
+	uint64_t size = inst.size();
+	std::memcpy(header + 8, &size, 8);
+	out.write(header, binary_header_internal);
+
+	// Values are buffered, and flushed in multiples of 8 bytes.
+	std::vector<unsigned char> buffer;
+	buffer.reserve((1 << 16) + 16);
+	uint64_t hash = 0;
+	auto flush = [&](bool last) {
+		std::size_t bytes = last ? buffer.size() : buffer.size() / 8 * 8;
+		hash = binary_checksum_internal(hash, buffer.data(), bytes);
+		out.write(reinterpret_cast<const char *>(buffer.data()), bytes);
+		buffer.erase(buffer.begin(), buffer.begin() + bytes);
+	};
+	for (uint64_t i = 0; i < size; ++i) {
+		T value = inst[i];
+		if constexpr (std::is_integral_v<T>)
+			if (varint) {
+				uint64_t zigzag = static_cast<uint64_t>(value);
+				if constexpr (std::is_signed_v<T>)
+					zigzag = zigzag << 1 ^ (value < 0 ? ~0ULL : 0);
+				for (; zigzag >= 0x80; zigzag >>= 7)
+					buffer.push_back(zigzag | 0x80);
+				buffer.push_back(zigzag);
+			}
+		if (!varint) {
+			std::size_t at = buffer.size();
+			buffer.resize(at + sizeof(T));
+			std::memcpy(buffer.data() + at, &value, sizeof(T));
+		}
+		if (buffer.size() >= 1 << 16)
+			flush(false);
+	}
+	flush(true);
+	out.write(reinterpret_cast<const char *>(&hash), 8);
+	if (!out)
+		throw error_internal("could not write binary instance");
+}
+
+// Read-only view of a binary instance of values of type T. Raw values are
+// accessed in the mapped file, without copies; varint values are decoded once.
+template <typename T> struct binary_view {
+	using value_type = T;			  // Value type, for templates.
+	std::shared_ptr<const T> values_; // Values, kept alive with their file.
+	std::size_t size_;				  // Number of values.
+	bool add_1_;					  // If should add 1, for printing.
+
+	// Loads the binary instance in path, checking its header and checksum.
+	binary_view(const std::string &path) {
+		auto [file, file_size] = map_file_internal(path);
+		const unsigned char *bytes = file.get();
+		auto ensure = [&](bool cond, const std::string &msg) {
+			if (!cond)
+				throw error_internal("invalid binary instance `" + path +
+									 "`: " + msg);
+		};
+		ensure(file_size >= binary_header_internal + 8 and
+				   std::memcmp(bytes, binary_magic_internal, 4) == 0,
+			   "not a tgen binary instance");
+		ensure(bytes[4] == 1, "unknown format version");
+		ensure(bytes[5] == binary_type_internal<T>(),
+			   "values are not of the requested type");
+		uint8_t flags = bytes[6];
+		add_1_ = flags & binary_add_1_internal;
+		uint64_t size;
+		std::memcpy(&size, bytes + 8, 8);
+		size_ = size;
+
+		const unsigned char *payload = bytes + binary_header_internal;
+		std::size_t payload_size = file_size - binary_header_internal - 8;
+		uint64_t hash;
+		std::memcpy(&hash, payload + payload_size, 8);
+		ensure(binary_checksum_internal(0, payload, payload_size) == hash,
+			   "wrong checksum");
+
+		if (!(flags & binary_varint_internal)) {
+			ensure(payload_size == size_ * sizeof(T), "wrong size");
+			values_ = std::shared_ptr<const T>(
+				file, reinterpret_cast<const T *>(payload));
+			return;
+		}
+
+		std::shared_ptr<T[]> decoded(new T[size_]);
+		const unsigned char *at = payload, *end = payload + payload_size;
+		for (std::size_t i = 0; i < size_; ++i) {
+			uint64_t zigzag = 0;
+			for (int shift = 0;; shift += 7) {
+				ensure(at < end and shift < 64, "wrong size");
+				zigzag |= static_cast<uint64_t>(*at & 0x7F) << shift;
+				if (!(*at++ & 0x80))
+					break;
+			}
+			if constexpr (std::is_signed_v<T>)
+				zigzag = zigzag >> 1 ^ (~(zigzag & 1) + 1);
+			decoded[i] = static_cast<T>(zigzag);
+		}
+		ensure(at == end, "wrong size");
+		values_ = std::shared_ptr<const T>(decoded, decoded.get());
+	}
+
+	// Fetches size.
+	std::size_t size() const { return size_; }
+
+	// Fetches position idx.
+	const T &operator[](std::size_t idx) const { return values_.get()[idx]; }
+
+	// Values, contiguous.
+	const T *data() const { return values_.get(); }
+	const T *begin() const { return data(); }
+	const T *end() const { return data() + size_; }
+
+	// Sets that should print values 1-based.
+	binary_view &add_1() {
+		add_1_ = true;
+		return *this;
+	}
+
+	// Prints in stdout, separated by spaces, as the instance.
+	friend std::ostream &operator<<(std::ostream &out,
+									const binary_view &view) {
+		for (std::size_t i = 0; i < view.size(); ++i) {
+			if (i > 0)
+				out << ' ';
+			if (view.add_1_)
+				out << view[i] + 1;
+			else
+				out << view[i];
+		}
+		return out;
+	}
+
+	// Gets a std::vector with the values.
+	std::vector<T> to_std() const { return std::vector<T>(begin(), end()); }
+};
+
 /****************
  *              *
  *   SEQUENCE   *
@@ -333,36 +1918,51 @@ template <typename T> struct sequence : gen_base<sequence<T>> {
 						  // represents the index in this set)
 	std::map<T, int>
 		value_idx_in_set_; // Index of every value in the set above.
-	std::vector<std::pair<T, T>> val_range_; // Range of values of each index.
-	std::vector<std::vector<int>> neigh_;	 // Adjacency list of equality.
+	std::vector<std::pair<T, T>>
+		val_range_; // Range of values of each index. Empty until a `set`.
+	std::vector<std::pair<int, int>> equal_; // Pairs of `equal`.
 	std::vector<std::set<int>>
 		distinct_constraints_; // All distinct constraints.
+	std::vector<std::pair<int, int>>
+		different_; // Pairs of `different`, kept apart from the distinct
+					// constraints to sample paths of them directly.
+	std::pmr::memory_resource *resource_ =
+		nullptr; // Memory for temporary data. If null, use a pooled one.
+	int mixing_sweeps_ = 0; // Sweeps of Glauber dynamics. If 0, automatic.
+	std::optional<long long> sum_; // Sum of the values, if restricted.
+	std::map<T, int> counts_;	   // Exact number of times of counted values.
+	enum class order_internal { any, sorted, increasing };
+	order_internal order_ = order_internal::any; // Order of the values.
 
 	// Creates generator for sequences of size 'size', with random T in [l, r].
 	sequence(int size, T value_l, T value_r)
-		: size_(size), value_l_(value_l), value_r_(value_r), neigh_(size) {
+		: size_(size), value_l_(value_l), value_r_(value_r) {
 		tgen_ensure(size_ > 0, "size must be positive");
 		tgen_ensure(value_l_ <= value_r_, "value range must be valid");
-		for (int i = 0; i < size_; ++i)
-			val_range_.emplace_back(value_l_, value_r_);
 	}
 
 	// Creates sequence with value set.
 	sequence(int size, std::set<T> values)
-		: size_(size), values_(values), neigh_(size) {
+		: size_(size), values_(values) {
 		tgen_ensure(size_ > 0, "size must be positive");
 		tgen_ensure(!values.empty(), "value set must be non-empty");
 		value_l_ = 0, value_r_ = values.size() - 1;
-		for (int i = 0; i < size_; ++i)
-			val_range_.emplace_back(value_l_, value_r_);
 		int idx = 0;
 		for (T value : values_)
 			value_idx_in_set_[value] = idx++;
 	}
 
+	// Range of values of index.
+	std::pair<T, T> range_internal(int idx) const {
+		return val_range_.empty() ? std::pair(value_l_, value_r_)
+								  : val_range_[idx];
+	}
+
 	// Restricts sequences for sequence[idx] = value.
 	sequence &set(int idx, T value) {
 		tgen_ensure(0 <= idx and idx < size_, "index must be valid");
+		if (val_range_.empty())
+			val_range_.assign(size_, {value_l_, value_r_});
 		if (values_.size() == 0) {
 			auto &[left, right] = val_range_[idx];
 			if (left == right and value_l_ != value_r_) {
@@ -393,8 +1993,7 @@ template <typename T> struct sequence : gen_base<sequence<T>> {
 		if (idx_1 == idx_2)
 			return *this;
 
-		neigh_[idx_1].push_back(idx_2);
-		neigh_[idx_2].push_back(idx_1);
+		equal_.emplace_back(idx_1, idx_2);
 		return *this;
 	}
 
@@ -418,8 +2017,12 @@ template <typename T> struct sequence : gen_base<sequence<T>> {
 
 	// Restricts sequences for sequence[idx_1] != sequence[idx_2].
 	sequence &different(int idx_1, int idx_2) {
-		std::set<int> indices = {idx_1, idx_2};
-		return distinct(indices);
+		tgen_ensure(0 <= std::min(idx_1, idx_2) and
+						std::max(idx_1, idx_2) < size_,
+					"indices must be valid");
+		if (idx_1 != idx_2)
+			different_.emplace_back(idx_1, idx_2);
+		return *this;
 	}
 
 	// Restricts sequences with distinct elements.
@@ -430,6 +2033,70 @@ template <typename T> struct sequence : gen_base<sequence<T>> {
 		return distinct(indices);
 	}
 
+	// Uses resource for the temporary data of generation.
+	sequence &memory_resource(std::pmr::memory_resource *resource) {
+		resource_ = resource;
+		return *this;
+	}
+
+	// Restricts sequences for the sum of the values to be `value`.
+	sequence &sum(long long value) {
+		static_assert(std::is_integral_v<T>, "sum requires integral values");
+		tgen_ensure(values_.empty(), "sum requires a range of values");
+		sum_ = value;
+		return *this;
+	}
+
+	// Restricts sequences for value to appear exactly 'count' times.
+	sequence &count(T value, int count) {
+		static_assert(std::is_integral_v<T>, "count requires integral values");
+		tgen_ensure(count >= 0, "count must be non-negative");
+		if (values_.empty()) {
+			tgen_ensure(value_l_ <= value and value <= value_r_,
+						"value must be in the defined range");
+		} else {
+			tgen_ensure(values_.count(value),
+						"value must be in the set of values");
+		}
+		auto [it, inserted] = counts_.emplace(value, count);
+		tgen_ensure(inserted or it->second == count,
+					"must not count a value with two different counts");
+		return *this;
+	}
+
+	// Restricts sequences for every value in `frequencies` to appear exactly
+	// its frequency times.
+	sequence &frequencies(const std::map<T, int> &frequencies) {
+		for (auto [value, count] : frequencies)
+			this->count(value, count);
+		return *this;
+	}
+
+	// Restricts sequences to be non-decreasing.
+	sequence &sorted() {
+		order_ = order_internal::sorted;
+		return *this;
+	}
+
+	// Restricts sequences to be strictly increasing.
+	sequence &increasing() {
+		order_ = order_internal::increasing;
+		return *this;
+	}
+
+	// Sets the number of sweeps of Glauber dynamics, used for distinct
+	// constraints that are too complex to be sampled exactly.
+	sequence &mixing_sweeps(int sweeps) {
+		tgen_ensure(sweeps > 0, "number of sweeps must be positive");
+		mixing_sweeps_ = sweeps;
+		return *this;
+	}
+
+	// Memory resource for temporary data.
+	std::pmr::memory_resource *scratch_internal() const {
+		return resource_ ? resource_ : scratch_resource_internal();
+	}
+
 	// Sequence instance.
 	// Operations on an instance are not random.
 	struct instance {
@@ -437,6 +2104,7 @@ template <typename T> struct sequence : gen_base<sequence<T>> {
 		std::vector<T> vec_;  // Sequence.
 
 		instance(const std::vector<T> &vec) : vec_(vec) {}
+		instance(std::vector<T> &&vec) : vec_(std::move(vec)) {}
 		instance(const std::initializer_list<T> &il)
 			: vec_(il.begin(), il.end()) {}
 
@@ -449,7 +2117,7 @@ template <typename T> struct sequence : gen_base<sequence<T>> {
 
 		// Sorts values in non-decreasing order.
 		instance &sort() {
-			std::sort(vec_.begin(), vec_.end());
+			sort_internal(vec_);
 			return *this;
 		}
 
@@ -484,38 +2152,45 @@ template <typename T> struct sequence : gen_base<sequence<T>> {
 
 	// Generates a uniformly random list of k distinct values in `[value_l,
 	// value_r]`, such that no value is in `forbidden_values`.
-	std::vector<T>
-	generate_distinct_values(int k, const std::set<T> &forbidden_values) {
+	template <typename SET = std::set<T>>
+	std::vector<T> generate_distinct_values(int k,
+											const SET &forbidden_values) {
 		for (auto forbidden : forbidden_values)
 			tgen_ensure(value_l_ <= forbidden and forbidden <= value_r_);
-		// We generate our numbers in the range [0, num_available) with
-		// num_available = (r-l+1)-(forbidden_values.size()), and then map them
-		// to the correct range. We will run k steps of Fisher–Yates, using a
-		// map to store a virtual sequence that starts with a[i] = i.
-		T num_available = (value_r_ - value_l_ + 1) - forbidden_values.size();
-		if (num_available < k)
+		tgen_stats_internal(
+			stats_scope_internal scope(stats::distinct_values);
+			++stats::distinct_values_calls;
+			stats::distinct_values_forbidden += forbidden_values.size();)
+		// We generate our numbers in the range [0, last] with
+		// last = (r-l)-(forbidden_values.size()), as offsets that do not
+		// overflow on the full range, and then map them to the correct range.
+		// We will run k steps of Fisher–Yates, using a map to store a virtual
+		// sequence that starts with a[i] = i.
+		using U = unsigned long long;
+		U span = static_cast<U>(value_r_) - static_cast<U>(value_l_);
+		if (k > 0 and k - 1 + forbidden_values.size() > span)
 			throw error_internal(
 				"failed to generate sequence: complex constraints");
-		std::map<T, T> virtual_list;
+		U last = span - forbidden_values.size();
+		scratch_scope_internal scratch;
+		std::pmr::map<U, U> virtual_list(scratch_internal());
 		std::vector<T> gen_list;
 		for (int i = 0; i < k; i++) {
-			T j = next<T>(i, num_available - 1);
-			T vj = virtual_list.count(j) ? virtual_list[j] : j;
-			T vi = virtual_list.count(i) ? virtual_list[i] : i;
+			U j = next<U>(i, last);
+			U vj = virtual_list.count(j) ? virtual_list[j] : j;
+			U vi = virtual_list.count(i) ? virtual_list[i] : i;
 
 			virtual_list[j] = vi, virtual_list[i] = vj;
 
-			gen_list.push_back(virtual_list[i]);
+			// Shifts back to correct range, but there might still be values
+			// that we can not use.
+			gen_list.push_back(
+				static_cast<T>(static_cast<U>(value_l_) + virtual_list[i]));
 		}
 
-		// Shifts back to correct range, but there might still be values
-		// that we can not use.
-		for (T &value : gen_list)
-			value += value_l_;
-
 		// Now for every generated value, we shift it by how many forbidden
 		// values are <= to it.
-		std::vector<std::pair<T, int>> values_sorted;
+		std::pmr::vector<std::pair<T, int>> values_sorted(scratch_internal());
 		for (std::size_t i = 0; i < gen_list.size(); ++i)
 			values_sorted.emplace_back(gen_list[i], i);
 		// We iterate through them in increasing order.
@@ -532,46 +2207,931 @@ template <typename T> struct sequence : gen_base<sequence<T>> {
 		return gen_list;
 	}
 
-	// Generates sequence instance.
-	instance gen() {
-		std::vector<T> vec(size_);
-		std::vector<bool> defined_idx(
-			size_, false); // For every index, if it has been set in `vec`.
+	// Constraint class of the generator, for stats.
+	int stats_class_internal() const {
+		int mask = distinct_constraints_.empty() and different_.empty()
+					   ? 0
+					   : stats::distinct_bit;
+		for (auto [left, right] : val_range_)
+			if (left == right and value_l_ != value_r_)
+				mask |= stats::set_bit;
+		if (!equal_.empty())
+			mask |= stats::equal_bit;
+		return mask;
+	}
 
-		std::vector<int> comp_id(size_, -1); // Component id of each index.
-		std::vector<std::vector<int>> comp(size_); // Component of each comp-id.
-		int comp_count = 0; // Number of different components.
+	// Defines the components linked by `different` constraints, if they form
+	// paths, sampling each path uniformly in one sweep. Returns false, defining
+	// nothing, if some component is in three constraints or there is a cycle.
+	// Walks of e steps from value a to value b that never repeat a value in a
+	// row are counted in closed form: with K values and y = (-1/(K-1))^e, their
+	// number is proportional to 1 + (K-1)y if a = b, and to 1 - y otherwise.
+	template <typename DEFINE>
+	bool gen_different_paths_internal(const std::pmr::vector<int> &comp_id,
+									  const std::pmr::vector<int> &comp_idx,
+									  const std::pmr::vector<int> &comp_start,
+									  const std::vector<T> &vec,
+									  const std::pmr::vector<bool> &defined_idx,
+									  DEFINE define_comp,
+									  std::pmr::memory_resource *res) {
+		if (!std::is_integral_v<T>)
+			return false;
+		int comp_count = comp_start.size() - 1;
 
-		// Defines value of entire component.
-		auto define_comp = [&](int cur_comp, T val) {
-			for (int idx : comp[cur_comp]) {
-				tgen_ensure(!defined_idx[idx]);
-				vec[idx] = val;
-				defined_idx[idx] = true;
+		// Neighbours of each component, at most two.
+		std::pmr::vector<int> adj(2 * comp_count, -1, res);
+		for (auto [idx_1, idx_2] : different_) {
+			int comp_1 = comp_id[idx_1], comp_2 = comp_id[idx_2];
+			if (comp_1 == comp_2)
+				contradiction_error_internal(
+					"sequence", "tried to set two indices as equal and "
+								"different");
+			for (auto [cur, nxt] : {std::pair(comp_1, comp_2),
+									std::pair(comp_2, comp_1)}) {
+				if (adj[2 * cur] == -1)
+					adj[2 * cur] = nxt;
+				else if (adj[2 * cur + 1] == -1)
+					adj[2 * cur + 1] = nxt;
+				else
+					return false;
 			}
-		};
+		}
 
-		// Groups = components.
-		{
-			std::vector<bool> vis(size_, false); // Visited for each index.
-			for (int idx = 0; idx < size_; ++idx)
-				if (!vis[idx]) {
-					T new_value;
-					bool value_defined = false;
+		// Lists the components of each path, starting from an endpoint.
+		std::pmr::vector<int> order(res);
+		std::pmr::vector<int> path_start(1, 0, res);
+		std::pmr::vector<bool> vis(comp_count, false, res);
+		for (int comp = 0; comp < comp_count; ++comp) {
+			if (vis[comp] or adj[2 * comp] == -1 or adj[2 * comp + 1] != -1)
+				continue;
+			for (int prv = -1, cur = comp; cur != -1;) {
+				vis[cur] = true;
+				order.push_back(cur);
+				int nxt = adj[2 * cur] != prv ? adj[2 * cur] : adj[2 * cur + 1];
+				prv = cur, cur = nxt;
+			}
+			path_start.push_back(order.size());
+		}
+		for (int comp = 0; comp < comp_count; ++comp)
+			if (!vis[comp] and adj[2 * comp] != -1)
+				return false; // Cycle.
 
-					// BFS to visit the connected component, grouping equal
-					// values.
-					std::queue<int> q({idx});
-					vis[idx] = true;
-					std::vector<int> component;
-					while (!q.empty()) {
-						int cur_idx = q.front();
-						q.pop();
+		long double k = static_cast<long double>(value_r_) - value_l_ + 1;
+		// Weights of walks of e steps between equal and different values.
+		auto walks = [&](int e) -> std::pair<long double, long double> {
+			if (e <= 1)
+				return {e == 0, e == 1};
+			if (k == 2)
+				return {e % 2 == 0, e % 2 == 1};
+			if (e >= 64)
+				return {1, 1}; // y is negligible.
+			long double y = std::pow(-1 / (k - 1), e);
+			return {1 + (k - 1) * y, 1 - y};
+		};
+		// Uniform value other than a and b.
+		auto draw_except = [&](T a, T b) {
+			if (a > b)
+				std::swap(a, b);
+			T val = next<T>(value_l_, value_r_ - (a == b ? 1 : 2));
+			if (val >= a)
+				++val;
+			if (a != b and val >= b)
+				++val;
+			return val;
+		};
+		auto defined = [&](int comp) {
+			return defined_idx[comp_idx[comp_start[comp]]];
+		};
+		auto value = [&](int comp) { return vec[comp_idx[comp_start[comp]]]; };
 
-						component.push_back(cur_idx);
+		// Samples each path from its first component, weighting each value by
+		// the number of ways to reach the next defined component.
+		std::pmr::vector<int> next_defined(order.size(), res);
+		for (std::size_t path = 0; path + 1 < path_start.size(); ++path) {
+			int first = path_start[path], last = path_start[path + 1];
+			for (int i = last - 1, nxt = last; i >= first; --i) {
+				if (defined(order[i]))
+					nxt = i;
+				next_defined[i] = nxt;
+			}
 
-						// Checks value.
-						auto [l, r] = val_range_[cur_idx];
+			T prv_val{};
+			for (int i = first; i < last; ++i) {
+				int comp = order[i];
+				bool has_prv = i > first;
+				if (defined(comp)) {
+					if (has_prv and value(comp) == prv_val)
+						contradiction_error_internal(
+							"sequence", "tried to set two indices as equal and "
+										"different");
+					prv_val = value(comp);
+					continue;
+				}
+
+				T val;
+				if (next_defined[i] == last) {
+					val = has_prv ? draw_except(prv_val, prv_val)
+								  : next<T>(value_l_, value_r_);
+				} else {
+					T target = value(order[next_defined[i]]);
+					auto [same, diff] = walks(next_defined[i] - i);
+					if (has_prv and prv_val == target) {
+						if (diff == 0)
+							contradiction_error_internal("sequence");
+						val = draw_except(target, target);
+					} else {
+						long double total = same + (k - 1 - has_prv) * diff;
+						if (total == 0)
+							contradiction_error_internal("sequence");
+						if (next<long double>(0, 1) * total < same)
+							val = target;
+						else
+							val = draw_except(has_prv ? prv_val : target,
+											  target);
+					}
+				}
+				define_comp(comp, val);
+				prv_val = val;
+			}
+		}
+		return true;
+	}
+
+	// Defines the components in `distincts` as a random list coloring:
+	// defined components have a list of one value, the others of all values,
+	// and the values in each distinct constraint must differ. Samples exactly
+	// by rejection if its acceptance rate is high. Otherwise, runs Glauber
+	// dynamics from a greedy coloring, resampling each component among the
+	// values not used by its neighbours, for `mixing_sweeps_` sweeps (by
+	// default, from Jerrum's bound if there are more than twice as many values
+	// as the maximum degree).
+	template <typename DEFINE>
+	void gen_coloring_internal(const std::vector<std::set<int>> &distincts,
+							   const std::pmr::vector<int> &comp_id,
+							   const std::pmr::vector<int> &comp_idx,
+							   const std::pmr::vector<int> &comp_start,
+							   const std::vector<T> &vec,
+							   const std::pmr::vector<bool> &defined_idx,
+							   DEFINE define_comp,
+							   std::pmr::memory_resource *res) {
+		if constexpr (!std::is_integral_v<T>) {
+			throw error_internal(
+				"failed to generate sequence: complex constraints");
+		} else {
+			int comp_count = comp_start.size() - 1;
+
+			// Components of each constraint, and constraints of each
+			// component.
+			std::pmr::vector<int> members(res), member_start(1, 0, res);
+			std::pmr::vector<int> cons(res), cons_start(comp_count + 1, 0, res);
+			for (const std::set<int> &distinct : distincts) {
+				for (int idx : distinct) {
+					members.push_back(comp_id[idx]);
+					++cons_start[comp_id[idx] + 1];
+				}
+				member_start.push_back(members.size());
+			}
+			for (int comp = 0; comp < comp_count; ++comp)
+				cons_start[comp + 1] += cons_start[comp];
+			cons.resize(members.size());
+			{
+				std::pmr::vector<int> pos(cons_start.begin(),
+										  cons_start.end() - 1, res);
+				for (std::size_t c = 0; c + 1 < member_start.size(); ++c)
+					for (int i = member_start[c]; i < member_start[c + 1]; ++i)
+						cons[pos[members[i]]++] = c;
+			}
+
+			// Free components in some constraint, by non-increasing degree.
+			std::pmr::vector<T> color(comp_count, res);
+			std::pmr::vector<bool> colored(comp_count, false, res);
+			std::pmr::vector<std::pair<int, int>> free_comps(res);
+			for (int comp = 0; comp < comp_count; ++comp) {
+				int rep = comp_idx[comp_start[comp]];
+				if (defined_idx[rep]) {
+					color[comp] = vec[rep], colored[comp] = true;
+					continue;
+				}
+				int degree = 0;
+				for (int i = cons_start[comp]; i < cons_start[comp + 1]; ++i)
+					degree +=
+						member_start[cons[i] + 1] - member_start[cons[i]] - 1;
+				if (degree > 0)
+					free_comps.emplace_back(-degree, comp);
+			}
+			std::sort(free_comps.begin(), free_comps.end());
+			int max_degree = free_comps.empty() ? 0 : -free_comps[0].first;
+			long double k = static_cast<long double>(value_r_) - value_l_ + 1;
+
+			// Uniform value not in `used`, that is sorted and unique.
+			std::pmr::vector<T> used(res);
+			auto draw_unused = [&]() {
+				T val = next<T>(value_l_, value_r_ - used.size());
+				for (T u : used)
+					if (u <= val)
+						++val;
+				return val;
+			};
+			// Fills `used` with the values of the colored neighbours.
+			auto collect_used = [&](int comp) {
+				used.clear();
+				for (int i = cons_start[comp]; i < cons_start[comp + 1]; ++i)
+					for (int j = member_start[cons[i]];
+						 j < member_start[cons[i] + 1]; ++j)
+						if (members[j] != comp and colored[members[j]])
+							used.push_back(color[members[j]]);
+				std::sort(used.begin(), used.end());
+				used.erase(std::unique(used.begin(), used.end()), used.end());
+			};
+
+			// Rejection, if the probability that independent values satisfy
+			// all constraints is at least about 5%.
+			long double log_accept = 0;
+			for (std::size_t c = 0; c + 1 < member_start.size(); ++c)
+				for (int j = 1; j < member_start[c + 1] - member_start[c]; ++j)
+					log_accept += std::log1p(-j / k);
+			bool sampled = false;
+			if (log_accept > -3) {
+				tgen_trace_internal("coloring rejection");
+				std::pmr::vector<T> values(res);
+				for (int tries = 0; tries < 256 and !sampled; ++tries) {
+					for (auto [degree, comp] : free_comps)
+						color[comp] = next<T>(value_l_, value_r_);
+					sampled = true;
+					for (std::size_t c = 0;
+						 c + 1 < member_start.size() and sampled; ++c) {
+						values.clear();
+						for (int j = member_start[c]; j < member_start[c + 1];
+							 ++j)
+							values.push_back(color[members[j]]);
+						std::sort(values.begin(), values.end());
+						sampled = std::adjacent_find(values.begin(),
+													 values.end()) ==
+								  values.end();
+					}
+				}
+			}
+
+			if (!sampled) {
+				tgen_trace_internal("coloring glauber");
+				for (auto [degree, comp] : free_comps) {
+					collect_used(comp);
+					if (used.size() >= k)
+						throw error_internal(
+							"failed to generate sequence: complex constraints");
+					color[comp] = draw_unused();
+					colored[comp] = true;
+				}
+
+				int sweeps = mixing_sweeps_;
+				if (sweeps == 0) {
+					long double rate =
+						k > 2 * max_degree
+							? (k - max_degree) / (k - 2 * max_degree)
+							: 4;
+					long double n = free_comps.size() + 1;
+					sweeps = std::ceil(rate * std::log(n / 1e-3));
+				}
+				for (int sweep = 0; sweep < sweeps; ++sweep)
+					for (auto [degree, comp] : free_comps) {
+						collect_used(comp);
+						color[comp] = draw_unused();
+					}
+			}
+
+			for (auto [degree, comp] : free_comps)
+				define_comp(comp, color[comp]);
+		}
+	}
+
+	// Engine without equality and distinct constraints: one pass over the
+	// sequence.
+	void gen_fill_internal(std::vector<T> &vec) {
+		tgen_trace_internal("fill engine");
+		if (size_ <= fill_block_internal) {
+			for (int idx = 0; idx < size_; ++idx) {
+				auto [left, right] = range_internal(idx);
+				vec[idx] = left == right ? left : next<T>(left, right);
+			}
+			return;
+		}
+		tgen_stats_internal(stats::rng_draws[stats_category_internal] +=
+							size_;)
+		auto fill = [&](auto &engine, long long first, long long last) {
+			fill_range_internal(engine, first, last, vec.data() + first);
+		};
+		parallel_fill_internal(fill_key_internal(), 0, size_, fill);
+	}
+
+	// Fills the indices in [first, last) from `engine` into `out`.
+	template <typename ENGINE>
+	void fill_range_internal(ENGINE &engine, long long first, long long last,
+							 T *out) const {
+		for (long long idx = first; idx < last; ++idx) {
+			auto [left, right] = range_internal(idx);
+			*out++ = left == right ? left : next_internal(engine, left, right);
+		}
+	}
+
+	// Engine of sorted and increasing sequences without other constraints.
+	// Calls `emit(value)` for the values in order, without storing them.
+	// Integral sequences are sorted subsets: an increasing sequence is a subset
+	// of the values, and a sorted one is a subset of the positions of the
+	// values ("stars") among the separators between distinct values ("bars").
+	// Reals are the order statistics of uniform values, drawn in order.
+	template <typename F> void gen_ordered_internal(F &&emit) {
+		tgen_trace_internal("ordered engine");
+		if (sum_ or !val_range_.empty() or !equal_.empty() or
+			!distinct_constraints_.empty() or !different_.empty())
+			throw error_internal(
+				"sorted sequences can not be combined with other constraints");
+		unsigned long long n = size_;
+
+		if constexpr (std::is_floating_point_v<T>) {
+			long double cur = value_l_;
+			for (unsigned long long left = n; left > 0; --left) {
+				long double u = next<long double>(0, 1);
+				cur += (value_r_ - cur) * (1 - std::pow(u, 1.0L / left));
+				emit(static_cast<T>(cur));
+			}
+		} else {
+			// Number of values minus 1, and value of offset `x`.
+			unsigned long long span =
+				static_cast<unsigned long long>(value_r_) -
+				static_cast<unsigned long long>(value_l_);
+			auto value = [&](unsigned long long x) {
+				return static_cast<T>(
+					static_cast<unsigned long long>(value_l_) + x);
+			};
+			tgen_ensure(span <= ~0ULL - n, "range of values is too large");
+
+			if (order_ == order_internal::increasing) {
+				if (span < n - 1)
+					contradiction_error_internal(
+						"sequence", "not enough values for an increasing "
+									"sequence");
+				if (n <= (span + 1) / 2) {
+					sorted_subset_internal(span + 1, n, [&](auto x) {
+						emit(value(x));
+					});
+					return;
+				}
+				// Draws the values not taken, if fewer.
+				unsigned long long x = 0;
+				sorted_subset_internal(span + 1, span + 1 - n, [&](auto skip) {
+					for (; x < skip; ++x)
+						emit(value(x));
+					++x;
+				});
+				for (; x <= span; ++x)
+					emit(value(x));
+				return;
+			}
+
+			if (n <= span) {
+				// Stars: the value of the i-th star is the number of bars
+				// before it.
+				unsigned long long i = 0;
+				sorted_subset_internal(n + span, n, [&](auto star) {
+					emit(value(star - i++));
+				});
+				return;
+			}
+			// Bars: the stars between consecutive bars have the same value.
+			unsigned long long prv = 0, x = 0;
+			sorted_subset_internal(n + span, span, [&](auto bar) {
+				for (; prv < bar; ++prv)
+					emit(value(x));
+				++prv, ++x;
+			});
+			for (; prv < n + span; ++prv)
+				emit(value(x));
+		}
+	}
+
+	// Engine without distinct constraints: union-find over the equality
+	// pairs, and one value per component, drawn at its first index.
+	void gen_equal_internal(std::vector<T> &vec) {
+		tgen_trace_internal("equal engine");
+		std::pmr::memory_resource *res = scratch_internal();
+		std::pmr::vector<int> parent(size_, res);
+		std::iota(parent.begin(), parent.end(), 0);
+		auto find = [&](int idx) {
+			while (parent[idx] != idx)
+				idx = parent[idx] = parent[parent[idx]];
+			return idx;
+		};
+		for (auto [idx_1, idx_2] : equal_)
+			parent[find(idx_1)] = find(idx_2);
+
+		// Value of each component, from its set indices.
+		std::pmr::vector<bool> root_defined(size_, false, res);
+		std::pmr::vector<T> root_value(size_, res);
+		for (int idx = 0; idx < size_; ++idx) {
+			auto [left, right] = range_internal(idx);
+			if (left != right)
+				continue;
+			int root = find(idx);
+			if (root_defined[root] and root_value[root] != left)
+				contradiction_error_internal(
+					"sequence", "tried to set value to `" +
+									std::to_string(root_value[root]) +
+									"`, but it was already set as `" +
+									std::to_string(left) + "`");
+			root_defined[root] = true, root_value[root] = left;
+		}
+
+		for (int idx = 0; idx < size_; ++idx) {
+			int root = find(idx);
+			if (!root_defined[root]) {
+				root_defined[root] = true;
+				root_value[root] = next<T>(value_l_, value_r_);
+			}
+			vec[idx] = root_value[root];
+		}
+	}
+
+	// Engine for a single distinct constraint, without other constraints: its
+	// values are drawn without replacement, from a shuffled array of all
+	// values if there are few, and with a hash set of the drawn ones
+	// otherwise.
+	void gen_distinct_internal(std::vector<T> &vec) {
+		tgen_trace_internal("distinct engine");
+		std::pmr::memory_resource *res = scratch_internal();
+		const std::set<int> &indices = distinct_constraints_[0];
+		// Number of values minus 1, that does not overflow on the full range.
+		unsigned long long span = static_cast<unsigned long long>(value_r_) -
+								  static_cast<unsigned long long>(value_l_);
+		if (indices.size() - 1 > span)
+			contradiction_error_internal(
+				"sequence", "tried to generate " +
+								std::to_string(indices.size()) +
+								" distinct values, but the maximum is " +
+								std::to_string(span + 1));
+
+		if (span < 2 * indices.size()) {
+			std::size_t k = span + 1;
+			std::pmr::vector<T> values(k, res);
+			std::iota(values.begin(), values.end(), value_l_);
+			std::size_t i = 0;
+			for (int idx : indices) {
+				std::swap(values[i], values[next<std::size_t>(i, k - 1)]);
+				vec[idx] = values[i++];
+			}
+		} else {
+			// Open addressing table of the drawn values, at most 1/4 full.
+			int bits = 2;
+			while ((std::size_t(1) << bits) < 4 * indices.size())
+				++bits;
+			std::pmr::vector<T> drawn(std::size_t(1) << bits, res);
+			std::pmr::vector<bool> used(drawn.size(), false, res);
+			for (int idx : indices)
+				for (bool found = true; found;) {
+					T val = next<T>(value_l_, value_r_);
+					std::size_t pos =
+						(static_cast<uint64_t>(val) * 0x9e3779b97f4a7c15ull) >>
+						(64 - bits);
+					while (used[pos] and drawn[pos] != val)
+						pos = (pos + 1) & (drawn.size() - 1);
+					found = used[pos];
+					used[pos] = true, drawn[pos] = vec[idx] = val;
+				}
+		}
+
+		auto it = indices.begin();
+		for (int idx = 0; idx < size_; ++idx)
+			if (it != indices.end() and *it == idx)
+				++it;
+			else
+				vec[idx] = next<T>(value_l_, value_r_);
+	}
+
+	// Engine for a fixed sum, with `set` constraints. With m free indices,
+	// b_i = a_i - l is in [0, u] and sums to some r. If u >= r, the bound is
+	// never active, and b is a uniform composition (stars and bars over a
+	// sorted subset). Otherwise, the first m - k parts are drawn from truncated
+	// geometric distributions of parameter x with mean r/m, and accepted with
+	// probability proportional to P(the last k parts sum to the rest), that is
+	// computed by dynamic programming with k^2 u = O(m). The last k parts are
+	// then drawn backwards from the same table. About sqrt(m/k) tries are
+	// expected. If u > m, k = 1 and the probability is x^t in closed form, so
+	// the cost does not depend on u.
+	void gen_sum_internal(std::vector<T> &vec) {
+		tgen_trace_internal("sum engine");
+		std::pmr::memory_resource *res = scratch_internal();
+		long long rest = *sum_;
+		std::pmr::vector<int> free_idx(res);
+		for (int idx = 0; idx < size_; ++idx) {
+			auto [left, right] = range_internal(idx);
+			if (left == right)
+				vec[idx] = left, rest -= left;
+			else
+				free_idx.push_back(idx);
+		}
+
+		long long m = free_idx.size(), u = value_r_ - value_l_;
+		long long r = rest - m * static_cast<long long>(value_l_);
+		if (r < 0 or
+			static_cast<long double>(r) > static_cast<long double>(m) * u)
+			contradiction_error_internal("sequence",
+										 "sum " + std::to_string(*sum_) +
+											 " is not reachable");
+		if (m == 0)
+			return;
+
+		std::pmr::vector<long long> parts(m, res);
+		if (u >= r) {
+			// Part i is the number of stars between bars i-1 and i.
+			long long prv = -1, i = 0;
+			sorted_subset_internal(r + m - 1, m - 1, [&](long long bar) {
+				parts[i++] = bar - prv - 1;
+				prv = bar;
+			});
+			parts[m - 1] = r + m - 2 - prv;
+		} else {
+			// Flips values so that the mean is at most u/2, and x <= 1.
+			bool flip = 2 * static_cast<long double>(r) >
+						static_cast<long double>(m) * u;
+			if (flip)
+				r = m * u - r;
+
+			// Mean of the truncated geometric, increasing in x. It is uniform
+			// if x^u is about 1.
+			auto uniform = [&](long double x) {
+				return (1 - x) * (u + 1) < 1e-9;
+			};
+			auto mean = [&](long double x) {
+				if (uniform(x))
+					return u / 2.0L;
+				long double xu = std::pow(x, u + 1);
+				return x / (1 - x) - (u + 1) * xu / (1 - xu);
+			};
+			long double lo = 0, hi = 1;
+			for (int it = 0; it < 100; ++it) {
+				long double mid = (lo + hi) / 2;
+				(mean(mid) < static_cast<long double>(r) / m ? lo : hi) = mid;
+			}
+			long double x = (lo + hi) / 2, log_x = std::log(x);
+			long double xu = std::pow(x, u + 1);
+			auto draw = [&]() -> long long {
+				if (uniform(x))
+					return next<long long>(0, u);
+				long double part =
+					std::floor(std::log1p(-next<long double>(0, 1) * (1 - xu)) /
+							   log_x);
+				return std::min<long double>(part, u);
+			};
+
+			// Row j of `dist` is proportional to the distribution of the sum
+			// of j parts, with maximum 1. For k = 1, the row is x^t and is not
+			// stored.
+			long long k = std::max(
+				1LL, std::min<long long>(m, std::sqrt(4.0L * m / (u + 1))));
+			long long width = k * u + 1;
+			std::pmr::vector<double> dist(k > 1 ? (k + 1) * width : 0, 0, res);
+			auto row = [&](long long j) { return dist.begin() + j * width; };
+			auto tail = [&](long long t) {
+				return k > 1 ? row(k)[t] : static_cast<double>(std::pow(x, t));
+			};
+			if (k > 1)
+				row(0)[0] = 1;
+			for (long long j = 1; j <= k and k > 1; ++j) {
+				auto prv = row(j - 1), cur = row(j);
+				double top = 0;
+				for (long long t = 0; t <= j * u; ++t) {
+					// Sliding sum of x^b prv[t - b], for b in [0, u].
+					double val = prv[t] + (t > 0 ? x * cur[t - 1] : 0);
+					if (t > u)
+						val -= xu * prv[t - u - 1];
+					cur[t] = std::max(val, 0.0);
+					top = std::max(top, cur[t]);
+				}
+				for (long long t = 0; t <= j * u; ++t)
+					cur[t] /= top;
+			}
+
+			long long last = 0;
+			for (bool accepted = false; !accepted;) {
+				last = r;
+				for (long long i = 0; i < m - k; ++i)
+					last -= parts[i] = draw();
+				accepted = 0 <= last and last < width and
+						   next<double>(0, 1) < tail(last);
+			}
+			if (k == 1)
+				parts[m - 1] = last;
+			for (long long j = k; j >= 1 and k > 1; --j) {
+				// Weights of the values of part j, given the sum of parts
+				// 1..j.
+				auto prv = row(j - 1);
+				double total = 0, weight = 1;
+				for (long long b = 0; b <= std::min(u, last); ++b, weight *= x)
+					if (last - b <= (j - 1) * u)
+						total += weight * prv[last - b];
+				double target = next<double>(0, total);
+				long long part = -1;
+				weight = 1;
+				for (long long b = 0; b <= std::min(u, last); ++b, weight *= x)
+					if (last - b <= (j - 1) * u and prv[last - b] > 0) {
+						part = b;
+						if ((target -= weight * prv[last - b]) < 0)
+							break;
+					}
+				parts[m - j] = part;
+				last -= part;
+			}
+			if (flip)
+				for (long long &part : parts)
+					part = u - part;
+		}
+
+		for (long long i = 0; i < m; ++i)
+			vec[free_idx[i]] = value_l_ + parts[i];
+	}
+
+	// Engine for exact counts of values, with `set`: the free indices get the
+	// missing copies of the counted values, and uniformly random uncounted
+	// values, in a uniformly random order.
+	void gen_count_internal(std::vector<T> &vec) {
+		tgen_trace_internal("count engine");
+		std::pmr::memory_resource *res = scratch_internal();
+		// Counted values, in the internal range, and their missing copies.
+		std::pmr::vector<std::pair<T, long long>> missing(res);
+		for (auto [value, count] : counts_)
+			missing.emplace_back(
+				values_.empty() ? value : T(value_idx_in_set_.at(value)),
+				count);
+		auto missing_of = [&](T value) -> long long * {
+			auto it = std::lower_bound(missing.begin(), missing.end(),
+									   std::pair<T, long long>(value, -1));
+			return it != missing.end() and it->first == value ? &it->second
+															  : nullptr;
+		};
+
+		std::pmr::vector<int> free_idx(res);
+		for (int idx = 0; idx < size_; ++idx) {
+			auto [left, right] = range_internal(idx);
+			if (left != right) {
+				free_idx.push_back(idx);
+				continue;
+			}
+			vec[idx] = left;
+			if (long long *count = missing_of(left); count and --*count < 0)
+				contradiction_error_internal(
+					"sequence", "a value is set more times than its count");
+		}
+
+		long long free = free_idx.size(), counted = 0;
+		for (auto [value, count] : missing)
+			counted += count;
+		// Uncounted values are in [value_l_, value_r_ - missing.size()], and
+		// value x is shifted by the number of counted values up to it: the
+		// number of i with `missing[i].first - i <= x`.
+		unsigned long long range = static_cast<unsigned long long>(value_r_) -
+								   static_cast<unsigned long long>(value_l_);
+		bool uncounted = range >= missing.size();
+		if (counted > free or (counted < free and !uncounted))
+			contradiction_error_internal(
+				"sequence", "counts add up to " + std::to_string(counted) +
+								" values, but there are " +
+								std::to_string(free) + " free indices");
+
+		std::pmr::vector<T> values(res), shifted(res);
+		values.reserve(free);
+		for (auto [value, count] : missing)
+			values.insert(values.end(), count, value);
+		for (std::size_t i = 0; i < missing.size(); ++i)
+			shifted.push_back(missing[i].first - static_cast<T>(i));
+		T uncounted_r = value_r_ - static_cast<T>(missing.size());
+		while (static_cast<long long>(values.size()) < free) {
+			T value = next<T>(value_l_, uncounted_r);
+			values.push_back(value + (std::upper_bound(shifted.begin(),
+													   shifted.end(), value) -
+									  shifted.begin()));
+		}
+		shuffle(values.begin(), values.end());
+		for (long long i = 0; i < free; ++i)
+			vec[free_idx[i]] = values[i];
+	}
+
+	// Generates sequence instance. The constraints are classified, and the
+	// common classes go to dedicated engines.
+	instance gen() {
+		tgen_stats_internal(stats_scope_internal scope(stats::sequence);
+							++stats::sequence_gen[stats_class_internal()];)
+		tgen_trace_internal("sequence::gen");
+		scratch_scope_internal scratch;
+		std::vector<T> vec(size_);
+
+		if (!counts_.empty()) {
+			if (order_ != order_internal::any or sum_ or !equal_.empty() or
+				!distinct_constraints_.empty() or !different_.empty())
+				throw error_internal("count can not be combined with order, "
+									 "sum, equality or distinct constraints");
+			gen_count_internal(vec);
+		} else if (order_ != order_internal::any) {
+			int idx = 0;
+			gen_ordered_internal([&](T val) { vec[idx++] = val; });
+		} else if (sum_) {
+			if (!equal_.empty() or !distinct_constraints_.empty() or
+				!different_.empty())
+				throw error_internal("sum can not be combined with equality "
+									 "or distinct constraints");
+			gen_sum_internal(vec);
+		} else if (distinct_constraints_.empty() and different_.empty()) {
+			if (equal_.empty())
+				gen_fill_internal(vec);
+			else
+				gen_equal_internal(vec);
+		} else if (std::is_integral_v<T> and equal_.empty() and
+				   val_range_.empty() and different_.empty() and
+				   distinct_constraints_.size() == 1) {
+			gen_distinct_internal(vec);
+		} else {
+			gen_general_internal(vec);
+		}
+
+		if (!values_.empty()) {
+			tgen_trace_internal("value set remap");
+			// Needs to fetch the values from the value set.
+			std::pmr::vector<T> value_vec(values_.begin(), values_.end(),
+										  scratch_internal());
+			for (T &val : vec)
+				val = value_vec[val];
+		}
+
+		return instance(std::move(vec));
+	}
+
+	// Generates sequence instance, calling `consume(value)` for its values in
+	// order. Sorted, increasing and independent values are not stored.
+	template <typename F> void gen_each(F consume) {
+		if (!counts_.empty() or
+			(order_ == order_internal::any and
+			 (sum_ or !equal_.empty() or !distinct_constraints_.empty() or
+			  !different_.empty()))) {
+			for (const T &val : gen().vec_)
+				consume(val);
+			return;
+		}
+
+		tgen_stats_internal(stats_scope_internal scope(stats::sequence);
+							++stats::sequence_gen[stats_class_internal()];)
+		tgen_trace_internal("sequence::gen_each");
+		scratch_scope_internal scratch;
+		std::pmr::vector<T> value_vec(values_.begin(), values_.end(),
+									  scratch_internal());
+		auto emit = [&](T val) {
+			consume(values_.empty() ? val : value_vec[val]);
+		};
+
+		if (order_ != order_internal::any) {
+			gen_ordered_internal(emit);
+		} else if (size_ <= fill_block_internal) {
+			for (int idx = 0; idx < size_; ++idx) {
+				auto [left, right] = range_internal(idx);
+				emit(left == right ? left : next<T>(left, right));
+			}
+		} else {
+			// Fills batches of blocks in parallel, with the values of `gen`.
+			tgen_stats_internal(stats::rng_draws[stats_category_internal] +=
+								size_;)
+			uint64_t key = fill_key_internal();
+			long long batch = thread_count_internal() * fill_block_internal;
+			std::pmr::vector<T> buf(std::min<long long>(batch, size_),
+									scratch_internal());
+			for (long long begin = 0; begin < size_; begin += batch) {
+				long long end = std::min<long long>(size_, begin + batch);
+				auto fill = [&](auto &engine, long long first, long long last) {
+					fill_range_internal(engine, first, last,
+										buf.data() + (first - begin));
+				};
+				parallel_fill_internal(key, begin, end, fill);
+				for (long long i = 0; i < end - begin; ++i)
+					emit(buf[i]);
+			}
+		}
+	}
+
+	// Reads an instance of `size` values from `in`, and checks that it
+	// satisfies all constraints.
+	instance read(reader &in) const {
+		tgen_trace_internal("sequence::read");
+		std::vector<T> vec = in.read<T>(size_);
+
+		for (int idx = 0; idx < size_; ++idx) {
+			auto [left, right] = range_internal(idx);
+			if (values_.empty()) {
+				tgen_ensure(left <= vec[idx] and vec[idx] <= right,
+							"read values must be in the defined range");
+			} else {
+				auto it = value_idx_in_set_.find(vec[idx]);
+				tgen_ensure(it != value_idx_in_set_.end(),
+							"read values must be in the set of values");
+				tgen_ensure(left <= it->second and it->second <= right,
+							"read values must satisfy `set`");
+			}
+		}
+		for (auto [idx_1, idx_2] : equal_)
+			tgen_ensure(vec[idx_1] == vec[idx_2],
+						"read values must satisfy `equal`");
+		for (auto [idx_1, idx_2] : different_)
+			tgen_ensure(vec[idx_1] != vec[idx_2],
+						"read values must satisfy `different`");
+		for (const std::set<int> &indices : distinct_constraints_) {
+			std::vector<T> values;
+			for (int idx : indices)
+				values.push_back(vec[idx]);
+			std::sort(values.begin(), values.end());
+			tgen_ensure(std::adjacent_find(values.begin(), values.end()) ==
+							values.end(),
+						"read values must satisfy `distinct`");
+		}
+		if constexpr (std::is_integral_v<T>)
+			if (sum_)
+				tgen_ensure(std::accumulate(vec.begin(), vec.end(), 0LL) ==
+								*sum_,
+							"read values must satisfy `sum`");
+		if (!counts_.empty()) {
+			std::map<T, int> counts;
+			for (const T &val : vec)
+				if (counts_.count(val))
+					++counts[val];
+			for (auto [value, count] : counts_)
+				tgen_ensure(counts[value] == count,
+							"read values must satisfy `count`");
+		}
+		if (order_ == order_internal::sorted)
+			tgen_ensure(std::is_sorted(vec.begin(), vec.end()),
+						"read values must satisfy `sorted`");
+		if (order_ == order_internal::increasing)
+			tgen_ensure(std::adjacent_find(vec.begin(), vec.end(),
+										   std::greater_equal<T>()) ==
+							vec.end(),
+						"read values must satisfy `increasing`");
+		return instance(std::move(vec));
+	}
+
+	// General solver, for any constraints.
+	void gen_general_internal(std::vector<T> &vec) {
+		std::pmr::memory_resource *res = scratch_internal();
+		std::pmr::vector<bool> defined_idx(
+			size_, false, res); // For every index, if it has been set in `vec`.
+
+		std::pmr::vector<int> comp_id(size_, -1,
+									  res); // Component id of each index.
+		std::pmr::vector<int> comp_idx(
+			res); // Indices, grouped by component.
+		std::pmr::vector<int> comp_start(
+			1, 0, res); // Start of each component in `comp_idx`.
+		comp_idx.reserve(size_);
+		int comp_count = 0; // Number of different components.
+
+		// Defines value of entire component.
+		auto define_comp = [&](int cur_comp, T val) {
+			for (int i = comp_start[cur_comp]; i < comp_start[cur_comp + 1];
+				 ++i) {
+				int idx = comp_idx[i];
+				tgen_ensure(!defined_idx[idx]);
+				vec[idx] = val;
+				defined_idx[idx] = true;
+			}
+		};
+
+		// Groups = components.
+		{
+			tgen_trace_internal("equality BFS");
+			// Adjacency list of equality.
+			std::pmr::vector<int> neigh_start(size_ + 1, 0, res);
+			std::pmr::vector<int> neigh(2 * equal_.size(), res);
+			for (auto [idx_1, idx_2] : equal_)
+				++neigh_start[idx_1 + 1], ++neigh_start[idx_2 + 1];
+			for (int idx = 0; idx < size_; ++idx)
+				neigh_start[idx + 1] += neigh_start[idx];
+			{
+				std::pmr::vector<int> pos(neigh_start.begin(),
+										  neigh_start.end() - 1, res);
+				for (auto [idx_1, idx_2] : equal_)
+					neigh[pos[idx_1]++] = idx_2, neigh[pos[idx_2]++] = idx_1;
+			}
+
+			std::pmr::vector<bool> vis(size_, false,
+									   res); // Visited for each index.
+			for (int idx = 0; idx < size_; ++idx)
+				if (!vis[idx]) {
+					T new_value;
+					bool value_defined = false;
+
+					// BFS to visit the connected component, grouping equal
+					// values. The component itself is the queue.
+					std::size_t head = comp_idx.size();
+					comp_idx.push_back(idx);
+					vis[idx] = true;
+					while (head < comp_idx.size()) {
+						int cur_idx = comp_idx[head++];
+
+						// Checks value.
+						auto [l, r] = range_internal(cur_idx);
 						if (l == r) {
 							if (!value_defined) {
 								// We found the value.
@@ -588,19 +3148,21 @@ template <typename T> struct sequence : gen_base<sequence<T>> {
 							}
 						}
 
-						for (int nxt_idx : neigh_[cur_idx]) {
+						for (int i = neigh_start[cur_idx];
+							 i < neigh_start[cur_idx + 1]; ++i) {
+							int nxt_idx = neigh[i];
 							if (!vis[nxt_idx]) {
 								vis[nxt_idx] = true;
-								q.push(nxt_idx);
+								comp_idx.push_back(nxt_idx);
 							}
 						}
 					}
 
 					// Group entire component, checking if value is defined.
-					for (int cur_idx : component) {
-						comp_id[cur_idx] = comp_count;
-						comp[comp_id[cur_idx]].push_back(cur_idx);
-					}
+					for (std::size_t i = comp_start.back(); i < comp_idx.size();
+						 ++i)
+						comp_id[comp_idx[i]] = comp_count;
+					comp_start.push_back(comp_idx.size());
 
 					// Sets value if needed.
 					if (value_defined)
@@ -610,24 +3172,47 @@ template <typename T> struct sequence : gen_base<sequence<T>> {
 				}
 		}
 
+		// Paths of `different` are sampled directly if there are no other
+		// distinct constraints. Otherwise, they join a copy of the general
+		// constraints, leaving the generator unchanged.
+		std::vector<std::set<int>> with_different;
+		const std::vector<std::set<int>> *distincts_ptr =
+			&distinct_constraints_;
+		if (!different_.empty()) {
+			tgen_trace_internal("different paths");
+			if (!distinct_constraints_.empty() or
+				!gen_different_paths_internal(comp_id, comp_idx, comp_start,
+											  vec, defined_idx, define_comp,
+											  res)) {
+				with_different = distinct_constraints_;
+				for (auto [idx_1, idx_2] : different_)
+					with_different.push_back({idx_1, idx_2});
+				distincts_ptr = &with_different;
+			}
+		}
+		const std::vector<std::set<int>> &distincts = *distincts_ptr;
+		// Number of values minus 1, that does not overflow on the full range.
+		unsigned long long span = static_cast<unsigned long long>(value_r_) -
+								  static_cast<unsigned long long>(value_l_);
+
 		// Initial parsing of distinct constraints.
-		std::vector<std::set<int>> distinct_containing_comp_idx(comp_count);
+		std::pmr::vector<std::pmr::set<int>> distinct_containing_comp_idx(
+			comp_count, res);
 		{
+			tgen_trace_internal("distinct parsing");
 			int dist_id = 0;
-			for (const std::set<int> &distinct : distinct_constraints_) {
+			for (const std::set<int> &distinct : distincts) {
 				// Checks if there are too many distinct values.
-				if (static_cast<unsigned long long>(distinct.size() - 1) +
-						static_cast<unsigned long long>(value_l_) >
-					static_cast<unsigned long long>(value_r_))
+				if (distinct.size() - 1 > span)
 					contradiction_error_internal(
 						"sequence",
 						"tried to generate " + std::to_string(distinct.size()) +
 							" distinct values, but the maximum is " +
-							std::to_string(value_r_ - value_l_ + 1));
+							std::to_string(span + 1));
 
 				// Checks if two values in same component are marked as
 				// different.
-				std::set<int> comp_ids;
+				std::pmr::set<int> comp_ids(res);
 				for (int idx : distinct) {
 					if (comp_ids.count(comp_id[idx]))
 						contradiction_error_internal(
@@ -642,24 +3227,33 @@ template <typename T> struct sequence : gen_base<sequence<T>> {
 		}
 
 		// If some value is in >= 3 sets, then there is a cycle.
+		bool complex = false;
 		for (auto &distinct_containing : distinct_containing_comp_idx)
 			if (distinct_containing.size() >= 3)
-				throw error_internal(
-					"failed to generate sequence: complex constraints");
+				complex = true;
 
-		std::vector<bool> vis_distinct(distinct_constraints_.size(), false);
-		std::vector<bool> initially_defined_comp_idx(comp_count, false);
+		std::pmr::vector<bool> vis_distinct(distincts.size(), false,
+											res);
+		std::pmr::vector<bool> initially_defined_comp_idx(comp_count, false,
+														  res);
+
+		// Distinct values, if there are enough values left.
+		auto distinct_values = [&](int k, const std::pmr::set<T> &forbidden) {
+			if (k > 0 and k - 1 + forbidden.size() > span)
+				throw complex_constraints_internal();
+			return generate_distinct_values(k, forbidden);
+		};
 
 		// Fills the value in a tree defined by distinct constraints.
 		auto define_tree = [&](int distinct_id) {
-			// The set `distinct_constraints_[distinct_id]` can have some values
+			// The set `distincts[distinct_id]` can have some values
 			// that are defined.
 
 			// Generates set of already defined values.
-			std::set<T> defined_values;
-			for (int idx : distinct_constraints_[distinct_id])
+			std::pmr::set<T> defined_values(res);
+			for (int idx : distincts[distinct_id])
 				if (defined_idx[idx]) {
-					// Checks if two values in `distinct_constraints_[dist_id]`
+					// Checks if two values in `distincts[dist_id]`
 					// have been set to the same value
 					if (defined_values.count(vec[idx]))
 						contradiction_error_internal(
@@ -672,12 +3266,12 @@ template <typename T> struct sequence : gen_base<sequence<T>> {
 			// Generates values in this root distinct constraint.
 			{
 				int new_value_count =
-					distinct_constraints_[distinct_id].size() -
+					distincts[distinct_id].size() -
 					static_cast<int>(defined_values.size());
 				std::vector<T> generated_values =
-					generate_distinct_values(new_value_count, defined_values);
+					distinct_values(new_value_count, defined_values);
 				auto val_it = generated_values.begin();
-				for (int idx : distinct_constraints_[distinct_id])
+				for (int idx : distincts[distinct_id])
 					if (defined_idx[idx]) {
 						// The root can cover these components, but there should
 						// not be any other defined in this tree.
@@ -689,15 +3283,17 @@ template <typename T> struct sequence : gen_base<sequence<T>> {
 			}
 
 			// BFS on the tree of distinct constraints.
-			std::queue<std::pair<int, int>> q; // {id, parent id}
+			using id_pair = std::pair<int, int>;
+			std::queue<id_pair, std::pmr::deque<id_pair>> q(
+				res); // {id, parent id}
 			q.emplace(distinct_id, -1);
 			vis_distinct[distinct_id] = true;
 			while (!q.empty()) {
 				auto [cur_distinct, parent] = q.front();
 				q.pop();
 
-				std::set<int> neigh_distinct;
-				for (int idx : distinct_constraints_[cur_distinct])
+				std::pmr::set<int> neigh_distinct(res);
+				for (int idx : distincts[cur_distinct])
 					for (int nxt_distinct :
 						 distinct_containing_comp_idx[comp_id[idx]]) {
 						if (nxt_distinct == cur_distinct or
@@ -706,8 +3302,7 @@ template <typename T> struct sequence : gen_base<sequence<T>> {
 
 						// Cycle found.
 						if (vis_distinct[nxt_distinct])
-							throw error_internal("failed to generate sequence: "
-												 "complex constraints");
+							throw complex_constraints_internal();
 
 						neigh_distinct.insert(nxt_distinct);
 					}
@@ -717,26 +3312,24 @@ template <typename T> struct sequence : gen_base<sequence<T>> {
 					q.emplace(nxt_distinct, cur_distinct);
 
 					// Generates this distinct constraint.
-					std::set<T> nxt_defined_values;
-					for (int idx2 : distinct_constraints_[nxt_distinct])
+					std::pmr::set<T> nxt_defined_values(res);
+					for (int idx2 : distincts[nxt_distinct])
 						if (defined_idx[idx2]) {
 							// There can not be any more defined. This case is
 							// when there are values not coverered by a single
 							// distinct constraint in the tree.
 							if (initially_defined_comp_idx[comp_id[idx2]])
-								throw error_internal(
-									"failed to generate sequence: "
-									"complex constraints");
+								throw complex_constraints_internal();
 
 							nxt_defined_values.insert(vec[idx2]);
 						}
 					int new_value_count =
-						distinct_constraints_[nxt_distinct].size() -
+						distincts[nxt_distinct].size() -
 						static_cast<int>(nxt_defined_values.size());
-					std::vector<T> generated_values = generate_distinct_values(
-						new_value_count, nxt_defined_values);
+					std::vector<T> generated_values =
+						distinct_values(new_value_count, nxt_defined_values);
 					auto val_it = generated_values.begin();
-					for (int idx2 : distinct_constraints_[nxt_distinct])
+					for (int idx2 : distincts[nxt_distinct])
 						if (!defined_idx[idx2]) {
 							define_comp(comp_id[idx2], *val_it);
 							++val_it;
@@ -749,10 +3342,11 @@ template <typename T> struct sequence : gen_base<sequence<T>> {
 		// by number of defined components (non-increasing). This guarantees
 		// that if there is a valid root (that covers all 'defined'), we find
 		// it.
+		std::pmr::vector<std::pair<int, int>> defined_cnt_and_distinct_idx(res);
 		{
-			std::vector<std::pair<int, int>> defined_cnt_and_distinct_idx;
+			tgen_trace_internal("sort defined counts");
 			int dist_id = 0;
-			for (const std::set<int> &distinct : distinct_constraints_) {
+			for (const std::set<int> &distinct : distincts) {
 				int defined_cnt = 0;
 				for (int idx : distinct)
 					if (defined_idx[idx]) {
@@ -765,33 +3359,45 @@ template <typename T> struct sequence : gen_base<sequence<T>> {
 
 			std::sort(defined_cnt_and_distinct_idx.rbegin(),
 					  defined_cnt_and_distinct_idx.rend());
-			for (auto [defined_cnt, distinct_idx] :
-				 defined_cnt_and_distinct_idx)
-				if (!vis_distinct[distinct_idx])
-					define_tree(distinct_idx);
 		}
 
-		// Loops through distinct constraints do define the rest.
-		for (std::size_t dist_id = 0; dist_id < distinct_constraints_.size();
-			 ++dist_id)
-			if (!vis_distinct[dist_id])
-				define_tree(dist_id);
+		// Distinct constraints that are not trees go to the list coloring
+		// solver, from the values defined before the trees.
+		std::pmr::vector<bool> defined_before_trees(defined_idx, res);
+		if (!complex) {
+			tgen_trace_internal("distinct trees");
+			try {
+				for (auto [defined_cnt, distinct_idx] :
+					 defined_cnt_and_distinct_idx)
+					if (!vis_distinct[distinct_idx])
+						define_tree(distinct_idx);
+
+				// Loops through distinct constraints do define the rest.
+				for (std::size_t dist_id = 0; dist_id < distincts.size();
+					 ++dist_id)
+					if (!vis_distinct[dist_id])
+						define_tree(dist_id);
+			} catch (const complex_constraints_internal &) {
+				complex = true;
+			}
+		}
+		if (complex) {
+			tgen_trace_internal("list coloring");
+			defined_idx = defined_before_trees;
+			gen_coloring_internal(distincts, comp_id, comp_idx, comp_start,
+								  vec, defined_idx, define_comp, res);
+		}
 
 		// Define final values. These values all should be random in [l, r], and
 		// the distinct constraints have already been processed. However, there
 		// can be still equality constraints, so we set entire components.
-		for (int idx = 0; idx < size_; ++idx)
-			if (!defined_idx[idx])
-				define_comp(comp_id[idx], next<T>(value_l_, value_r_));
-
-		if (!values_.empty()) {
-			// Needs to fetch the values from the value set.
-			std::vector<T> value_vec(values_.begin(), values_.end());
-			for (T &val : vec)
-				val = value_vec[val];
+		{
+			tgen_trace_internal("final fill");
+			for (int idx = 0; idx < size_; ++idx)
+				if (!defined_idx[idx])
+					define_comp(comp_id[idx], next<T>(value_l_, value_r_));
 		}
 
-		return instance(vec);
 	}
 };
 
@@ -810,6 +3416,7 @@ template <typename INST> INST shuffle(const INST &inst) {
 
 // Choses any value in the sequence.
 template <typename INST> typename INST::value_type any(const INST &inst) {
+	tgen_stats_internal(stats_scope_internal scope(stats::any);)
 	return inst.vec_[next<int>(0, inst.vec_.size() - 1)];
 }
 
@@ -817,6 +3424,7 @@ template <typename INST> typename INST::value_type any(const INST &inst) {
 template <typename INST> INST choose(int k, const INST &inst) {
 	tgen_ensure(0 < k and k <= inst.vec_.size(),
 				"number of elements to choose must be valid");
+	tgen_stats_internal(stats_scope_internal scope(stats::choose);)
 	std::vector<typename INST::value_type> new_vec;
 	int need = k;
 	for (int i = 0; need > 0; ++i) {
@@ -826,10 +3434,1164 @@ template <typename INST> INST choose(int k, const INST &inst) {
 			need--;
 		}
 	}
-	return INST(new_vec);
-}
+	return INST(new_vec);
+}
+
+}; // namespace sequence_op
+
+/*
+ * Fixed-size sequence generator.
+ *
+ * Variant of `sequence` for small sequences of known shape, generated in tight
+ * loops. The size is a template parameter, storage is `std::array`, and the
+ * domain of values is a policy, so generation does no heap allocation.
+ * Constraints can be added in `constexpr`.
+ */
+
+// Index of the lowest set bit of a nonzero mask.
+constexpr int ctz_internal(uint64_t mask) {
+#if defined(__GNUC__) || defined(__clang__)
+	return __builtin_ctzll(mask);
+#else
+	int count = 0;
+	for (; !(mask & 1); mask >>= 1)
+		++count;
+	return count;
+#endif
+}
+
+// Number of set bits of a mask.
+constexpr int popcount_internal(uint64_t mask) {
+#if defined(__GNUC__) || defined(__clang__)
+	return __builtin_popcountll(mask);
+#else
+	int count = 0;
+	for (; mask; mask &= mask - 1)
+		++count;
+	return count;
+#endif
+}
+
+// Domain of the values in [l, r].
+template <typename T> struct range_domain {
+	T value_l_, value_r_; // Range of values.
+
+	constexpr range_domain(T value_l, T value_r)
+		: value_l_(value_l), value_r_(value_r) {
+		tgen_ensure(value_l_ <= value_r_, "value range must be valid");
+	}
+
+	// Number of values.
+	constexpr unsigned long long size() const {
+		if constexpr (std::is_integral_v<T>)
+			return static_cast<unsigned long long>(value_r_) -
+				   static_cast<unsigned long long>(value_l_) + 1;
+		else
+			return value_l_ == value_r_ ? 1 : ~0ull;
+	}
+	constexpr bool contains(T value) const {
+		return value_l_ <= value and value <= value_r_;
+	}
+	T draw() const { return next<T>(value_l_, value_r_); }
+	template <typename ENGINE> T draw(ENGINE &engine) const {
+		return next_internal(engine, value_l_, value_r_);
+	}
+	// Value of rank k.
+	T at(unsigned long long k) const {
+		if constexpr (std::is_integral_v<T>)
+			return static_cast<T>(
+				static_cast<unsigned long long>(value_l_) + k);
+		else
+			return value_l_;
+	}
+};
+
+// Domain of the values in a set.
+template <typename T> struct set_domain {
+	std::vector<T> values_; // Sorted values.
+
+	set_domain(const std::set<T> &values)
+		: values_(values.begin(), values.end()) {
+		tgen_ensure(!values_.empty(), "value set must be non-empty");
+	}
+
+	// Number of values.
+	unsigned long long size() const { return values_.size(); }
+	bool contains(T value) const {
+		return std::binary_search(values_.begin(), values_.end(), value);
+	}
+	T draw() const { return values_[next<int>(0, values_.size() - 1)]; }
+	template <typename ENGINE> T draw(ENGINE &engine) const {
+		return values_[next_internal<int>(engine, 0, values_.size() - 1)];
+	}
+	// Value of rank k.
+	T at(unsigned long long k) const { return values_[k]; }
+};
+
+template <typename T, int N, typename DOMAIN = range_domain<T>>
+struct static_sequence : gen_base<static_sequence<T, N, DOMAIN>> {
+	static_assert(0 < N and N <= 64, "size must be in [1, 64]");
+	using mask = uint64_t; // Set of indices.
+
+	// Maximum number of rejected draws in generation.
+	static constexpr int max_rejections = 1 << 12;
+
+	DOMAIN domain_;					  // Possible values.
+	std::array<int, N> parent_{};	  // Union-find of equality.
+	std::array<bool, N> defined_{};	  // If each index was set.
+	std::array<T, N> value_{};		  // Value of each set index.
+	std::array<mask, N> different_{}; // Indices different from each index.
+
+	// Creates generator for sequences with random T in [l, r].
+	template <typename D = DOMAIN,
+			  std::enable_if_t<std::is_same_v<D, range_domain<T>>, int> = 0>
+	constexpr static_sequence(T value_l, T value_r)
+		: domain_(value_l, value_r) {
+		for (int i = 0; i < N; ++i)
+			parent_[i] = i;
+	}
+
+	// Creates generator for sequences with values in a set.
+	template <typename D = DOMAIN,
+			  std::enable_if_t<std::is_same_v<D, set_domain<T>>, int> = 0>
+	static_sequence(const std::set<T> &values) : domain_(values) {
+		for (int i = 0; i < N; ++i)
+			parent_[i] = i;
+	}
+
+	// Representative of the equality component of index.
+	constexpr int find_internal(int idx) const {
+		while (parent_[idx] != idx)
+			idx = parent_[idx];
+		return idx;
+	}
+
+	// Restricts sequences for sequence[idx] = value.
+	constexpr static_sequence &set(int idx, T value) {
+		tgen_ensure(0 <= idx and idx < N, "index must be valid");
+		tgen_ensure(domain_.contains(value),
+					"value must be in the domain of values");
+		tgen_ensure(!defined_[idx] or value_[idx] == value,
+					"must not set to two different values");
+		defined_[idx] = true, value_[idx] = value;
+		return *this;
+	}
+
+	// Restricts sequences for sequence[idx_1] = sequence[idx_2].
+	constexpr static_sequence &equal(int idx_1, int idx_2) {
+		tgen_ensure(0 <= std::min(idx_1, idx_2) and std::max(idx_1, idx_2) < N,
+					"indices must be valid");
+		parent_[find_internal(idx_1)] = find_internal(idx_2);
+		return *this;
+	}
+
+	// Restricts sequences for sequence[left..right] to have all equal values.
+	constexpr static_sequence &equal_range(int left, int right) {
+		tgen_ensure(0 <= left and left <= right and right < N,
+					"range indices bust be valid");
+		for (int i = left; i < right; ++i)
+			equal(i, i + 1);
+		return *this;
+	}
+
+	// Restricts sequences for sequence[S] to be distinct, for given subset S of
+	// indices.
+	template <typename C>
+	constexpr static_sequence &distinct(const C &indices) {
+		mask all = 0;
+		for (int idx : indices) {
+			tgen_ensure(0 <= idx and idx < N, "indices must be valid");
+			all |= mask(1) << idx;
+		}
+		for (int idx : indices)
+			different_[idx] |= all & ~(mask(1) << idx);
+		return *this;
+	}
+	constexpr static_sequence &distinct(std::initializer_list<int> indices) {
+		return distinct<std::initializer_list<int>>(indices);
+	}
+
+	// Restricts sequences for sequence[idx_1] != sequence[idx_2].
+	constexpr static_sequence &different(int idx_1, int idx_2) {
+		return distinct({idx_1, idx_2});
+	}
+
+	// Restricts sequences with distinct elements.
+	constexpr static_sequence &distinct() {
+		for (int i = 0; i < N; ++i)
+			different_[i] = (~mask(0) >> (64 - N)) & ~(mask(1) << i);
+		return *this;
+	}
+
+	// Fixed-size sequence instance.
+	// Operations on an instance are not random.
+	struct instance {
+		using value_type = T;	   // Value type, for templates.
+		std::array<T, N> vec_; // Sequence.
+
+		instance(const std::array<T, N> &vec) : vec_(vec) {}
+
+		// Fetches size.
+		std::size_t size() const { return N; }
+
+		// Fetches position idx.
+		T &operator[](int idx) { return vec_[idx]; }
+		const T &operator[](int idx) const { return vec_[idx]; }
+
+		// Sorts values in non-decreasing order.
+		instance &sort() {
+			std::sort(vec_.begin(), vec_.end());
+			return *this;
+		}
+
+		// Reverses sequence.
+		instance &reverse() {
+			std::reverse(vec_.begin(), vec_.end());
+			return *this;
+		}
+
+		// Prints in stdout, separated by spaces.
+		friend std::ostream &operator<<(std::ostream &out,
+										const instance &inst) {
+			for (int i = 0; i < N; ++i) {
+				if (i > 0)
+					out << ' ';
+				out << inst[i];
+			}
+			return out;
+		}
+
+		// Gets a std::array representing the instance.
+		std::array<T, N> to_std() const { return vec_; }
+	};
+
+	// Samples the values of the tree of components `tree` of the difference
+	// graph exactly, into `value`. Values not set in the tree are symmetric,
+	// so the number of ways to complete the subtree of a component depends
+	// only on its class of value: one of the set values, or any other value.
+	void gen_tree_internal(mask tree, const std::array<bool, N> &comp_defined,
+						   const std::array<mask, N> &comp_different,
+						   std::array<T, N> &value) const {
+		// Set values of the tree, and the class of each component (-1 if not
+		// set).
+		std::array<T, N> set_values{};
+		std::array<int, N> cls{};
+		int set_count = 0;
+		for (mask rest = tree; rest; rest &= rest - 1) {
+			int c = ctz_internal(rest);
+			cls[c] = -1;
+			if (!comp_defined[c])
+				continue;
+			cls[c] = std::find(set_values.begin(),
+							   set_values.begin() + set_count, value[c]) -
+					 set_values.begin();
+			if (cls[c] == set_count)
+				set_values[set_count++] = value[c];
+		}
+		long double others =
+			static_cast<long double>(domain_.size()) - set_count;
+
+		// Components in BFS order from the first one, with their parents.
+		std::array<int, N> order{}, parent{};
+		int size = 0;
+		order[size++] = ctz_internal(tree), parent[order[0]] = -1;
+		mask seen = mask(1) << order[0];
+		for (int i = 0; i < size; ++i)
+			for (mask rest = comp_different[order[i]] & ~seen; rest;
+				 rest &= rest - 1) {
+				int c = ctz_internal(rest);
+				seen |= mask(1) << c;
+				parent[c] = order[i], order[size++] = c;
+			}
+
+		// ways[c][x]: ways to complete the subtree of c, if c has a value of
+		// class x (x = set_count for other values).
+		std::array<std::array<long double, N + 1>, N> ways;
+		auto total = [&](int c, int except) {
+			long double sum = 0;
+			for (int x = 0; x < set_count; ++x)
+				if (x != except)
+					sum += ways[c][x];
+			return sum + (others - (except == set_count)) * ways[c][set_count];
+		};
+		for (int i = size - 1; i >= 0; --i) {
+			int c = order[i];
+			for (int x = 0; x <= set_count; ++x)
+				ways[c][x] = cls[c] == -1 or cls[c] == x;
+			for (mask rest = comp_different[c] & tree; rest; rest &= rest - 1) {
+				int child = ctz_internal(rest);
+				if (child == parent[c])
+					continue;
+				for (int x = 0; x <= set_count; ++x)
+					ways[c][x] *= total(child, x);
+			}
+		}
+
+		// Samples the classes from the root, and other values uniformly.
+		std::array<int, N> comp_cls{};
+		for (int i = 0; i < size; ++i) {
+			int c = order[i];
+			int except = parent[c] == -1 ? -1 : comp_cls[parent[c]];
+			long double sum = total(c, except);
+			if (sum <= 0)
+				contradiction_error_internal("sequence");
+			long double target = next<long double>(0, 1) * sum;
+			int x = 0, last = -1; // Last class with ways, against rounding.
+			for (; x < set_count; ++x) {
+				if (x == except or ways[c][x] <= 0)
+					continue;
+				if (target < ways[c][x])
+					break;
+				target -= ways[c][x], last = x;
+			}
+			if (x == set_count and
+				(others - (except == set_count)) * ways[c][x] <= 0)
+				x = last;
+			comp_cls[c] = x;
+			if (x < set_count) {
+				value[c] = set_values[x];
+				continue;
+			}
+			for (bool used = true; used;) {
+				value[c] = domain_.draw();
+				used = std::find(set_values.begin(),
+								 set_values.begin() + set_count,
+								 value[c]) != set_values.begin() + set_count or
+					   (except == set_count and value[c] == value[parent[c]]);
+			}
+		}
+	}
+
+	// Generates the instance with the general `sequence` solver.
+	instance gen_general_internal() const {
+		std::optional<sequence<T>> seq;
+		if constexpr (std::is_same_v<DOMAIN, range_domain<T>>) {
+			seq.emplace(N, domain_.value_l_, domain_.value_r_);
+		} else {
+			std::set<T> values;
+			for (unsigned long long k = 0; k < domain_.size(); ++k)
+				values.insert(domain_.at(k));
+			seq.emplace(N, values);
+		}
+		for (int idx = 0; idx < N; ++idx) {
+			if (defined_[idx])
+				seq->set(idx, value_[idx]);
+			if (find_internal(idx) != idx)
+				seq->equal(idx, find_internal(idx));
+			for (int nxt = idx + 1; nxt < N; ++nxt)
+				if (different_[idx] >> nxt & 1)
+					seq->different(idx, nxt);
+		}
+		std::vector<T> vec = seq->gen().to_std();
+		std::array<T, N> arr;
+		std::copy(vec.begin(), vec.end(), arr.begin());
+		return instance(arr);
+	}
+
+	// Generates fixed-size sequence instance.
+	// Each connected component of the difference graph (between equality
+	// components) that is a tree, such as a path of `different`, is sampled
+	// exactly. The others are covered by cliques: the values of a clique are
+	// drawn distinct, and the remaining differences are checked by rejection,
+	// so the result is uniform. If rejection fails too often, the general
+	// `sequence` solver is used.
+	instance gen() const {
+		tgen_stats_internal(stats_scope_internal scope(stats::sequence);)
+		tgen_trace_internal("static_sequence::gen");
+
+		// Groups indices by component.
+		std::array<int, N> comp{}, root_comp{};
+		std::array<bool, N> comp_defined{};
+		std::array<T, N> comp_value{};
+		std::array<mask, N> comp_different{};
+		int comp_count = 0;
+		root_comp.fill(-1);
+		for (int idx = 0; idx < N; ++idx) {
+			int &root = root_comp[find_internal(idx)];
+			if (root == -1)
+				root = comp_count++;
+			int c = comp[idx] = root;
+			if (!defined_[idx])
+				continue;
+			if (comp_defined[c] and comp_value[c] != value_[idx])
+				contradiction_error_internal(
+					"sequence", "tried to set value to `" +
+									std::to_string(comp_value[c]) +
+									"`, but it was already set as `" +
+									std::to_string(value_[idx]) + "`");
+			comp_defined[c] = true, comp_value[c] = value_[idx];
+		}
+		for (int idx = 0; idx < N; ++idx)
+			for (int nxt = 0; nxt < N; ++nxt)
+				if (different_[idx] >> nxt & 1) {
+					if (comp[idx] == comp[nxt] or
+						(comp_defined[comp[idx]] and
+						 comp_defined[comp[nxt]] and
+						 comp_value[comp[idx]] == comp_value[comp[nxt]]))
+						contradiction_error_internal(
+							"sequence",
+							"tried to set two indices as equal and different");
+					comp_different[comp[idx]] |= mask(1) << comp[nxt];
+				}
+
+		// Greedily covers the components by cliques.
+		std::array<mask, N> cliques{};
+		int clique_count = 0;
+		mask covered = 0;
+		for (int c = 0; c < comp_count; ++c) {
+			if (covered >> c & 1)
+				continue;
+			mask clique = mask(1) << c;
+			for (int nxt = c + 1; nxt < comp_count; ++nxt)
+				if (!(covered >> nxt & 1) and
+					(comp_different[nxt] & clique) == clique)
+					clique |= mask(1) << nxt;
+			covered |= clique;
+			cliques[clique_count++] = clique;
+
+			unsigned long long clique_size = 0;
+			for (mask rest = clique; rest; rest &= rest - 1)
+				++clique_size;
+			if (clique_size > domain_.size())
+				contradiction_error_internal(
+					"sequence", "tried to generate " +
+									std::to_string(clique_size) +
+									" distinct values, but the maximum is " +
+									std::to_string(domain_.size()));
+		}
+
+		// Samples the trees of the difference graph, which are then fixed.
+		std::array<T, N> value = comp_value;
+		std::array<bool, N> fixed = comp_defined;
+		mask seen = 0;
+		for (int c = 0; c < comp_count; ++c) {
+			if (seen >> c & 1)
+				continue;
+			mask tree = mask(1) << c;
+			for (mask frontier = tree; frontier;) {
+				mask reach = 0;
+				for (mask rest = frontier; rest; rest &= rest - 1)
+					reach |= comp_different[ctz_internal(rest)];
+				frontier = reach & ~tree;
+				tree |= reach;
+			}
+			seen |= tree;
+			int vertices = 0, degrees = 0;
+			for (mask rest = tree; rest; rest &= rest - 1) {
+				++vertices;
+				degrees += popcount_internal(
+					comp_different[ctz_internal(rest)]);
+			}
+			if (degrees / 2 != vertices - 1)
+				continue;
+			gen_tree_internal(tree, comp_defined, comp_different, value);
+			for (mask rest = tree; rest; rest &= rest - 1)
+				fixed[ctz_internal(rest)] = true;
+		}
+
+		for (int tries = 0; tries < max_rejections; ++tries) {
+			// Draws distinct values for the components of each clique that are
+			// not fixed.
+			for (int i = 0; i < clique_count; ++i) {
+				mask assigned = 0;
+				for (int c = 0; c < comp_count; ++c)
+					if ((cliques[i] >> c & 1) and fixed[c])
+						assigned |= mask(1) << c;
+				for (int c = 0; c < comp_count; ++c) {
+					if (!(cliques[i] >> c & 1) or fixed[c])
+						continue;
+					for (bool used = true; used;) {
+						value[c] = domain_.draw();
+						used = false;
+						for (int prv = 0; prv < comp_count; ++prv)
+							if ((assigned >> prv & 1) and
+								value[prv] == value[c])
+								used = true;
+					}
+					assigned |= mask(1) << c;
+				}
+			}
+
+			bool valid = true;
+			for (int c = 0; c < comp_count and valid; ++c)
+				for (int nxt = 0; nxt < comp_count; ++nxt)
+					if ((comp_different[c] >> nxt & 1) and
+						value[c] == value[nxt])
+						valid = false;
+			if (!valid)
+				continue;
+
+			std::array<T, N> vec;
+			for (int idx = 0; idx < N; ++idx)
+				vec[idx] = value[comp[idx]];
+			return instance(vec);
+		}
+
+		return gen_general_internal();
+	}
+};
+
+/*
+ * Lazy sequence generator.
+ *
+ * Variant of `sequence` for huge sequences, of which only some values are
+ * needed, or that are needed out of order. Value i of an instance is drawn on
+ * access from the Philox stream i, under a key drawn at generation, so the
+ * instance is never stored and any value is computed in O(1).
+ */
+
+template <typename T, typename DOMAIN = range_domain<T>>
+struct lazy_sequence : gen_base<lazy_sequence<T, DOMAIN>> {
+	long long size_;			 // Size of sequence.
+	DOMAIN domain_;				 // Possible values.
+	std::map<long long, T> set_; // Value of each set index.
+	bool distinct_ = false;		 // If values are distinct.
+
+	// Creates generator for sequences with random T in [l, r].
+	template <typename D = DOMAIN,
+			  std::enable_if_t<std::is_same_v<D, range_domain<T>>, int> = 0>
+	lazy_sequence(long long size, T value_l, T value_r)
+		: size_(size), domain_(value_l, value_r) {
+		tgen_ensure(size_ > 0, "size must be positive");
+	}
+
+	// Creates generator for sequences with values in a set.
+	template <typename D = DOMAIN,
+			  std::enable_if_t<std::is_same_v<D, set_domain<T>>, int> = 0>
+	lazy_sequence(long long size, const std::set<T> &values)
+		: size_(size), domain_(values) {
+		tgen_ensure(size_ > 0, "size must be positive");
+	}
+
+	// Restricts sequences for sequence[idx] = value.
+	lazy_sequence &set(long long idx, T value) {
+		tgen_ensure(0 <= idx and idx < size_, "index must be valid");
+		tgen_ensure(domain_.contains(value),
+					"value must be in the domain of values");
+		auto [it, inserted] = set_.emplace(idx, value);
+		tgen_ensure(inserted or it->second == value,
+					"must not set to two different values");
+		return *this;
+	}
+
+	// Restricts sequences with distinct elements. Value i is then the value of
+	// rank p(i) in the domain, for a keyed pseudo-random bijection p.
+	lazy_sequence &distinct() {
+		tgen_ensure((std::is_integral_v<T> or
+					 std::is_same_v<DOMAIN, set_domain<T>>),
+					"distinct values must be integral or in a set");
+		distinct_ = true;
+		return *this;
+	}
+
+	// Lazy sequence instance. Values are computed on access.
+	// Operations on an instance are not random.
+	struct instance {
+		using value_type = T;		 // Value type, for templates.
+		long long size_;			 // Size of sequence.
+		DOMAIN domain_;				 // Possible values.
+		std::map<long long, T> set_; // Value of each set index.
+		uint64_t key_;				 // Key of the Philox streams.
+		std::optional<feistel_internal>
+			distinct_; // Ranks of the values, if distinct.
+
+		// Fetches size.
+		long long size() const { return size_; }
+
+		// Computes position idx.
+		T operator[](long long idx) const {
+			if (distinct_)
+				return domain_.at((*distinct_)(idx));
+			if (!set_.empty()) {
+				auto it = set_.find(idx);
+				if (it != set_.end())
+					return it->second;
+			}
+			philox_internal engine(key_, idx);
+			return domain_.draw(engine);
+		}
+
+		// Prints in stdout, separated by spaces.
+		friend std::ostream &operator<<(std::ostream &out,
+										const instance &inst) {
+			for (long long i = 0; i < inst.size(); ++i) {
+				if (i > 0)
+					out << ' ';
+				out << inst[i];
+			}
+			return out;
+		}
+
+		// Gets a std::vector representing the instance.
+		std::vector<T> to_std() const {
+			std::vector<T> vec(size_);
+			int threads = work_threads_internal(size_);
+			parallel_internal(threads, [&](int t) {
+				long long last = size_ * (t + 1) / threads;
+				for (long long idx = size_ * t / threads; idx < last; ++idx)
+					vec[idx] = (*this)[idx];
+			});
+			return vec;
+		}
+	};
+
+	// Generates lazy sequence instance.
+	instance gen() const {
+		tgen_stats_internal(stats_scope_internal scope(stats::sequence);)
+		tgen_trace_internal("lazy_sequence::gen");
+		uint64_t key = fill_key_internal();
+		if (!distinct_)
+			return instance{size_, domain_, set_, key, std::nullopt};
+
+		if (!set_.empty())
+			throw error_internal(
+				"distinct lazy sequences can not be combined with set");
+		unsigned long long values = domain_.size(); // 0 for 2^64.
+		if (values != 0 and static_cast<unsigned long long>(size_) > values)
+			contradiction_error_internal(
+				"lazy_sequence", "tried to generate " + std::to_string(size_) +
+									 " distinct values, but the maximum is " +
+									 std::to_string(values));
+		return instance{size_, domain_, set_, key,
+						feistel_internal(values, key)};
+	}
+};
+
+/**************
+ *            *
+ *   STRING   *
+ *            *
+ **************/
+
+/*
+ * String generator.
+ *
+ * Strings over an alphabet, printed without separators. Constraints are kept
+ * in a `sequence<int>` over the indices of the characters in the alphabet.
+ * Without equality constraints, strings are filled in blocks on several
+ * threads, drawing several characters from each random word.
+ */
+
+struct string : gen_base<string> {
+	int size_;								 // Size of string.
+	std::string alphabet_;					 // Characters, sorted.
+	sequence<int> seq_;						 // Character index constraints.
+	std::vector<std::pair<int, char>> sets_; // {idx, character}.
+	bool equal_ = false;					 // If there are equalities.
+	int batch_;								 // Characters per random word.
+	uint32_t bound_;						 // Alphabet size ^ `batch_`.
+
+	// Creates generator for strings of size 'size', with characters in [l, r].
+	string(int size, char l, char r) : string(size, range_internal(l, r)) {}
+
+	// Creates generator for strings with characters in a set.
+	string(int size, const std::set<char> &alphabet)
+		: size_(size), alphabet_(alphabet_internal(alphabet)),
+		  seq_(size, 0, alphabet_.size() - 1) {
+		tgen_ensure(size_ > 0, "size must be positive");
+		uint64_t power = 1;
+		for (batch_ = 0;
+			 batch_ < 32 and power * alphabet_.size() <= UINT32_MAX; ++batch_)
+			power *= alphabet_.size();
+		bound_ = power;
+	}
+
+	static std::set<char> range_internal(char l, char r) {
+		tgen_ensure(l <= r, "character range must be valid");
+		std::set<char> chars;
+		for (int c = l; c <= r; ++c)
+			chars.insert(c);
+		return chars;
+	}
+	static std::string alphabet_internal(const std::set<char> &alphabet) {
+		tgen_ensure(!alphabet.empty(), "alphabet must be non-empty");
+		return std::string(alphabet.begin(), alphabet.end());
+	}
+
+	// Restricts strings for string[idx] = character.
+	string &set(int idx, char character) {
+		auto it =
+			std::lower_bound(alphabet_.begin(), alphabet_.end(), character);
+		tgen_ensure(it != alphabet_.end() and *it == character,
+					"character must be in the alphabet");
+		seq_.set(idx, it - alphabet_.begin());
+		sets_.emplace_back(idx, character);
+		return *this;
+	}
+
+	// Restricts strings for string[idx_1] = string[idx_2].
+	string &equal(int idx_1, int idx_2) {
+		seq_.equal(idx_1, idx_2);
+		equal_ = true;
+		return *this;
+	}
+
+	// Restricts strings for string[left..right] to have all equal characters.
+	string &equal_range(int left, int right) {
+		seq_.equal_range(left, right);
+		equal_ = true;
+		return *this;
+	}
+
+	// Restricts strings for string[left..right] to be a palindrome.
+	string &palindrome(int left, int right) {
+		tgen_ensure(0 <= left and left <= right and right < size_,
+					"range indices must be valid");
+		for (; left < right; ++left, --right)
+			equal(left, right);
+		return *this;
+	}
+
+	// Restricts strings to be palindromes.
+	string &palindrome() { return palindrome(0, size_ - 1); }
+
+	// String instance.
+	// Operations on an instance are not random.
+	struct instance {
+		using value_type = char; // Value type, for templates.
+		std::string str_;		 // String.
+
+		instance(const std::string &str) : str_(str) {}
+		instance(std::string &&str) : str_(std::move(str)) {}
+		instance(const char *str) : str_(str) {}
+
+		// Fetches size.
+		std::size_t size() const { return str_.size(); }
+
+		// Fetches position idx.
+		char &operator[](int idx) { return str_[idx]; }
+		const char &operator[](int idx) const { return str_[idx]; }
+
+		// Sorts characters in non-decreasing order, with a counting sort.
+		instance &sort() {
+			std::array<std::size_t, 256> count{};
+			for (char c : str_)
+				++count[static_cast<unsigned char>(c)];
+			auto it = str_.begin();
+			for (int c = 0; c < 256; ++c)
+				it = std::fill_n(it, count[c], static_cast<char>(c));
+			return *this;
+		}
+
+		// Reverses string.
+		instance &reverse() {
+			std::reverse(str_.begin(), str_.end());
+			return *this;
+		}
+
+		// Concatenates two instances.
+		instance operator+(const instance &rhs) const {
+			return instance(str_ + rhs.str_);
+		}
+
+		// Prints in stdout, without separators.
+		friend std::ostream &operator<<(std::ostream &out,
+										const instance &inst) {
+			return out << inst.str_;
+		}
+
+		// Gets a std::string representing the instance.
+		std::string to_std() const { return str_; }
+	};
+
+	// Fills [first, last) with random characters, drawn from `engine`. Each
+	// random word gives `batch_` characters, by multiplying it by the size of
+	// the alphabet once per character, with a rejection that keeps them
+	// uniform (Brackett-Rozinsky and Lemire, "Batched ranged random integer
+	// generation"). Characters are then looked up in the alphabet.
+	template <typename ENGINE>
+	void fill_internal(ENGINE &engine, char *first, char *last) const {
+		uint32_t k = alphabet_.size();
+		if (k == 1) {
+			std::fill(first, last, alphabet_[0]);
+			return;
+		}
+		// Local copies, since writes through `char*` may alias the members.
+		std::array<char, 256> alphabet;
+		std::copy(alphabet_.begin(), alphabet_.end(), alphabet.begin());
+		int batch_size = batch_;
+		uint32_t threshold = (0u - bound_) % bound_; // 2^32 mod bound.
+		std::array<uint8_t, 32> idx;
+		while (first != last) {
+			int batch = std::min<long long>(batch_size, last - first);
+			uint32_t word;
+			do {
+				word = engine();
+				for (int i = 0; i < batch_size; ++i) {
+					uint64_t prod = static_cast<uint64_t>(word) * k;
+					idx[i] = prod >> 32, word = prod;
+				}
+			} while (word < threshold);
+			for (int i = 0; i < batch; ++i)
+				first[i] = alphabet[idx[i]];
+			first += batch;
+		}
+	}
+
+	// Generates string instance.
+	instance gen() {
+		tgen_stats_internal(stats_scope_internal scope(stats::sequence);)
+		tgen_trace_internal("string::gen");
+		if (equal_) {
+			std::vector<int> idx = seq_.gen().vec_;
+			std::string str(size_, ' ');
+			for (int i = 0; i < size_; ++i)
+				str[i] = alphabet_[idx[i]];
+			return instance(std::move(str));
+		}
+
+		std::string str(size_, ' ');
+		tgen_stats_internal(stats::rng_draws[stats_category_internal] +=
+							size_;)
+		parallel_fill_internal(
+			fill_key_internal(), 0, size_,
+			[&](auto &engine, long long first, long long last) {
+				fill_internal(engine, str.data() + first, str.data() + last);
+			});
+		for (auto [idx, character] : sets_)
+			str[idx] = character;
+		return instance(std::move(str));
+	}
+};
+
+/*****************
+ *               *
+ *   PARTITION   *
+ *               *
+ *****************/
+
+/*
+ * Integer partition generator.
+ *
+ * Uniformly random partitions of n, by Boltzmann sampling: the number of parts
+ * of each size i is independent, with P(at least k) = x^(ik), and the result
+ * is uniform given that the sizes add up to n. With probabilistic divide and
+ * conquer (Arratia and DeSalvo), the number of parts of size 1 is not drawn:
+ * it is what is left to reach n, and it is accepted with probability x^(ones),
+ * so about n^(1/4) tries are needed. Only sizes with parts are visited, by
+ * skipping over the others, so a try takes about sqrt(n) time.
+ *
+ * A tight bound on the number of parts is kept exactly with a second
+ * parameter, that penalizes every part, and is undone by rejection. Parts
+ * are then spread over every size, so the sum is completed by the parts of
+ * several small sizes, drawn from a table of their weights.
+ */
+
+struct partition : gen_base<partition> {
+	int size_;			 // Sum of the parts.
+	int part_count_ = 0; // Number of parts, 0 if any.
+	int max_part_ = 0;	 // Maximum part, 0 if any.
+
+	// Creates generator for partitions of 'size'.
+	partition(int size) : size_(size) {
+		tgen_ensure(size_ > 0, "size must be positive");
+	}
+
+	// Restricts partitions to have 'count' parts.
+	partition &parts(int count) {
+		tgen_ensure(1 <= count and count <= size_,
+					"number of parts must be from 1 to size");
+		part_count_ = count;
+		return *this;
+	}
+
+	// Restricts partitions to have parts at most 'value'.
+	partition &max_part(int value) {
+		tgen_ensure(value > 0, "maximum part must be positive");
+		max_part_ = value;
+		return *this;
+	}
+
+	// Partition instance.
+	// Operations on an instance are not random.
+	struct instance {
+		using value_type = int;	 // Value type, for templates.
+		std::vector<int> parts_; // Parts, in non-increasing order.
+
+		instance(const std::vector<int> &parts) : parts_(parts) {
+			check_internal();
+		}
+		instance(std::vector<int> &&parts) : parts_(std::move(parts)) {
+			check_internal();
+		}
+		instance(const std::initializer_list<int> &il)
+			: instance(std::vector<int>(il.begin(), il.end())) {}
+
+		// Checks that the parts are positive, and sorts them.
+		void check_internal() {
+			for (int part : parts_)
+				tgen_ensure(part > 0, "parts must be positive");
+			std::sort(parts_.rbegin(), parts_.rend());
+		}
+
+		// Fetches number of parts.
+		std::size_t size() const { return parts_.size(); }
+
+		// Fetches part idx (parts are in non-increasing order).
+		const int &operator[](int idx) const { return parts_[idx]; }
+
+		// Conjugate partition: part j is the number of parts greater than j.
+		instance &conjugate() {
+			std::vector<int> conj(parts_.empty() ? 0 : parts_[0], 0);
+			for (int part : parts_)
+				++conj[part - 1];
+			for (int j = static_cast<int>(conj.size()) - 2; j >= 0; --j)
+				conj[j] += conj[j + 1];
+			parts_ = std::move(conj);
+			return *this;
+		}
+
+		// Prints in stdout, separated by spaces.
+		friend std::ostream &operator<<(std::ostream &out,
+										const instance &inst) {
+			for (std::size_t i = 0; i < inst.size(); ++i) {
+				if (i > 0)
+					out << ' ';
+				out << inst[i];
+			}
+			return out;
+		}
+
+		// Gets a std::vector representing the instance.
+		std::vector<int> to_std() const { return parts_; }
+
+		// Converts to the parts, so an instance can be given as the cycle
+		// sizes of `permutation::gen`.
+		operator std::vector<int>() const { return parts_; }
+	};
+
+	// Expected sum and number of parts, with parts at most `max_part`, when the
+	// number of parts of size i is geometric with ratio exp(-t i - s).
+	static std::pair<double, double>
+	boltzmann_moments_internal(double t, double s, int max_part) {
+		double x = std::exp(-t), zi = std::exp(-s), sum = 0, count = 0;
+		for (int i = 1; i <= max_part and (t <= 0 or zi > 1e-18); ++i) {
+			zi *= x;
+			sum += i * zi / (1 - zi);
+			count += zi / (1 - zi);
+		}
+		return {sum, count};
+	}
+
+	// Boltzmann parameters {t, s} for partitions of n with parts at most
+	// `max_part` and at most `max_count` parts: the expected sum is n, and
+	// s > 0 only if the expected number of parts would be over `max_count`, in
+	// which case it is `max_count`. The expected sum decreases with t and s,
+	// and the expected number of parts for that sum decreases with s.
+	static std::pair<double, double>
+	boltzmann_rate_internal(int n, int max_part, int max_count) {
+		auto sum = [&](double t, double s) {
+			return boltzmann_moments_internal(t, s, max_part).first;
+		};
+		// With s = 0, t is from about 1/n (only parts 1) to pi / sqrt(6n) (any
+		// part).
+		double lo = 0.25 / n, hi = 4 / std::sqrt(n);
+		for (int iter = 0; iter < 40; ++iter) {
+			double mid = std::sqrt(lo * hi);
+			(sum(mid, 0) > n ? lo : hi) = mid;
+		}
+		double t = std::sqrt(lo * hi);
+		if (boltzmann_moments_internal(t, 0, max_part).second <= max_count)
+			return {t, 0};
+
+		// With s > 0, t can be down to -s / max_part, where the ratio of parts
+		// of size `max_part` tends to 1.
+		auto rate = [&](double s) {
+			double t_lo = -s / max_part, t_hi = 4 / std::sqrt(n);
+			for (int iter = 0; iter < 40; ++iter) {
+				double mid = (t_lo + t_hi) / 2;
+				(sum(mid, s) > n ? t_lo : t_hi) = mid;
+			}
+			return (t_lo + t_hi) / 2;
+		};
+		auto count = [&](double s) {
+			return boltzmann_moments_internal(rate(s), s, max_part).second;
+		};
+		double s_lo = 0, s_hi = 1;
+		for (int iter = 0; iter < 60 and count(s_hi) > max_count; ++iter)
+			s_lo = s_hi, s_hi *= 2;
+		for (int iter = 0; iter < 30; ++iter) {
+			double mid = (s_lo + s_hi) / 2;
+			(count(mid) > max_count ? s_lo : s_hi) = mid;
+		}
+		return {rate(s_hi), s_hi};
+	}
+
+	// Draws a uniformly random partition of n with parts at most `max_part`
+	// and at most `max_count` parts, in non-increasing order. If the bound on
+	// the number of parts is tight, each part is penalized by a ratio exp(-s),
+	// so that the expected number of parts is `max_count`, and the result is
+	// accepted with probability exp(-s (max_count - parts)) to undo it.
+	static std::vector<int> sample_internal(int n, int max_part,
+											int max_count) {
+		if (n == 0)
+			return {};
+		max_part = std::min(max_part, n);
+		if (max_part == 1)
+			return std::vector<int>(n, 1);
+		double t, s;
+		std::tie(t, s) = boltzmann_rate_internal(n, max_part, max_count);
+		auto log_unit = [] { return std::log(1 - next<double>(0, 1)); };
+		auto ratio = [&](long long i) { return std::exp(-t * i - s); };
+
+		// Parts of size at most `small` complete the sum r left by the others
+		// (probabilistic divide and conquer): they are drawn with probability
+		// proportional to their weight, and the result is accepted with
+		// probability weight(r) / max weight, where weight(r) is the weight of
+		// all partitions of r into such parts. With parts of size 1, that is
+		// exp(-(t + s) r). With a tight number of parts, every size has a few
+		// parts, so more sizes are needed to complete the sum often enough;
+		// r is then at most small * max_count, and row v of `weight` is for
+		// the parts of size at most v + 1.
+		int small = 1;
+		std::vector<double> weight;
+		long long sums = 0;
+		double max_weight = 1;
+		if (s > 0)
+			small = std::clamp<long long>(std::sqrt((1 << 20) / max_count), 1,
+										  max_part);
+		if (small > 1) {
+			sums = std::min<long long>(n, 1LL * small * max_count) + 1;
+			weight.assign(small * sums, 0);
+			for (int v = 0; v < small; ++v) {
+				double *row = weight.data() + v * sums, z = ratio(v + 1);
+				for (long long r = 0; r < sums; ++r)
+					row[r] = (v ? row[r - sums] : r == 0) +
+							 (r > v ? z * row[r - v - 1] : 0);
+			}
+			max_weight = *std::max_element(weight.end() - sums, weight.end());
+		}
+		auto accept = [&](long long r) {
+			if (small == 1)
+				return log_unit() < -(t + s) * r;
+			return r < sums and next<double>(0, 1) * max_weight <
+									weight[(small - 1) * sums + r];
+		};
+
+		// {size, count} of the parts larger than `small`, and of the others.
+		std::vector<std::pair<int, long long>> counts, small_counts;
+		// About 5 n^(1/4) tries are expected if `max_count` is not tight, and
+		// about 50 (max_part / small)^(3/2) if it is, bounded so that hopeless
+		// constraints fail in reasonable time.
+		long long max_tries =
+			1000 + 100 * std::pow(n, 0.25) +
+			(s > 0 ? std::min(1000 * std::pow(1.0 * max_part / small, 1.5),
+							  2e9 / max_part)
+				   : 0);
+		for (long long tries = 0; tries < max_tries; ++tries) {
+			counts.clear();
+			long long sum = 0, count = 0;
+			for (long long i = small; sum <= n;) {
+				long long parts;
+				if (t > 0 and ratio(i + 1) < 0.5) {
+					// Sizes after i have parts with probability at most
+					// exp(-t (i+1) - s): skips to the next size with a part
+					// for that probability, and then accepts it with
+					// probability exp(-t (size - (i+1))).
+					long long base = i + 1;
+					double skip = std::floor(log_unit() /
+											 std::log1p(-ratio(base)));
+					if (skip > max_part - base)
+						break;
+					i = base + static_cast<long long>(skip);
+					if (log_unit() >= -t * (i - base))
+						continue;
+					parts = 1 + static_cast<long long>(log_unit() /
+													   (-t * i - s));
+				} else {
+					// Most sizes have parts: draws the number of parts of the
+					// next size directly.
+					if (++i > max_part)
+						break;
+					parts = static_cast<long long>(log_unit() / (-t * i - s));
+					if (parts == 0)
+						continue;
+				}
+				counts.emplace_back(i, parts);
+				sum += i * parts, count += parts;
+			}
+			if (sum > n or !accept(n - sum))
+				continue;
+
+			// Parts of size at most `small`, from the largest: while r is left,
+			// a part of size v + 1 is taken with probability given by its share
+			// of the weight of r in row v.
+			small_counts.clear();
+			for (long long v = small - 1, r = n - sum; r > 0; --v) {
+				const double *row = weight.data() + v * sums;
+				double z = ratio(v + 1);
+				long long parts = 0;
+				if (v == 0)
+					parts = r, r = 0;
+				while (v > 0 and r > v and
+					   next<double>(0, 1) * row[r] < z * row[r - v - 1])
+					++parts, r -= v + 1;
+				if (parts > 0)
+					small_counts.emplace_back(v + 1, parts), count += parts;
+			}
+			if (count > max_count or
+				(s > 0 and log_unit() >= -s * (max_count - count)))
+				continue;
+
+			std::vector<int> parts;
+			parts.reserve(count);
+			for (auto it = counts.rbegin(); it != counts.rend(); ++it)
+				parts.insert(parts.end(), it->second, it->first);
+			for (auto [size, parts_of_size] : small_counts)
+				parts.insert(parts.end(), parts_of_size, size);
+			return parts;
+		}
+		throw error_internal(
+			"failed to generate partition: complex constraints");
+	}
 
-}; // namespace sequence_op
+	// Generates partition instance.
+	instance gen() const {
+		tgen_stats_internal(stats_scope_internal scope(stats::partition);)
+		tgen_trace_internal("partition::gen");
+		int max_part = max_part_ ? max_part_ : size_;
+		if (part_count_ == 0)
+			return instance(sample_internal(size_, max_part, size_));
+
+		if (static_cast<long long>(part_count_) * max_part < size_)
+			contradiction_error_internal(
+				"partition",
+				"tried to generate " + std::to_string(part_count_) +
+					" parts of at most " + std::to_string(max_part) +
+					", but the sum is " + std::to_string(size_));
+
+		// Partitions of n into k parts at most m are (without 1 from each part)
+		// partitions of n-k into at most k parts at most m-1, that are the
+		// conjugates of the partitions of n-k into at most m-1 parts at most k.
+		// They are drawn with parts at most the smaller of k and m-1, so that
+		// tries are shorter and tight bounds are accepted more often.
+		int n = size_ - part_count_, rows = max_part - 1, cols = part_count_;
+		bool conjugate = cols <= rows;
+		if (!conjugate)
+			std::swap(rows, cols);
+		long long box = static_cast<long long>(rows) * cols;
+		std::vector<int> parts;
+		if (2 * n <= box)
+			parts = sample_internal(n, cols, rows);
+		else {
+			// Complement in the box of `rows` parts at most `cols`, that has a
+			// smaller sum, so fewer tries go over `rows` parts.
+			parts = sample_internal(static_cast<int>(box - n), cols, rows);
+			parts.resize(rows, 0);
+			std::reverse(parts.begin(), parts.end());
+			for (int &part : parts)
+				part = cols - part;
+			parts.erase(std::find(parts.begin(), parts.end(), 0), parts.end());
+		}
+		instance inst(std::move(parts));
+		if (conjugate)
+			inst.conjugate();
+		inst.parts_.resize(part_count_, 0);
+		for (int &part : inst.parts_)
+			++part;
+		return inst;
+	}
+};
 
 /*******************
  *                 *
@@ -846,6 +4608,8 @@ template <typename INST> INST choose(int k, const INST &inst) {
 struct permutation : gen_base<permutation> {
 	int size_;							   // Size of permutation.
 	std::vector<std::pair<int, int>> sets; // {idx, value}.
+	std::pmr::memory_resource *resource_ =
+		nullptr; // Memory for temporary data. If null, use a pooled one.
 
 	// Creates generator for permutation of size 'size'.
 	permutation(int size) : size_(size) {
@@ -859,6 +4623,12 @@ struct permutation : gen_base<permutation> {
 		return *this;
 	}
 
+	// Uses resource for the temporary data of generation.
+	permutation &memory_resource(std::pmr::memory_resource *resource) {
+		resource_ = resource;
+		return *this;
+	}
+
 	// Permutation instance.
 	// Operations on an instance are not random.
 	struct instance {
@@ -866,6 +4636,16 @@ struct permutation : gen_base<permutation> {
 		bool add_1_;		   // If should add 1, for printing.
 
 		instance(const std::vector<int> &vec) : vec_(vec), add_1_(false) {
+			check_internal();
+		}
+		instance(std::vector<int> &&vec) : vec_(std::move(vec)), add_1_(false) {
+			check_internal();
+		}
+		instance(const std::initializer_list<int> &il)
+			: instance(std::vector<int>(il.begin(), il.end())) {}
+
+		// Checks that `vec_` is a permutation.
+		void check_internal() const {
 			tgen_ensure(!vec_.empty(), "permutation cannot be empty");
 			std::vector<bool> vis(vec_.size(), false);
 			for (std::size_t i = 0; i < vec_.size(); i++) {
@@ -877,8 +4657,6 @@ struct permutation : gen_base<permutation> {
 				vis[vec_[i]] = true;
 			}
 		}
-		instance(const std::initializer_list<int> &il)
-			: instance(std::vector<int>(il.begin(), il.end())) {}
 
 		// Fetches size.
 		std::size_t size() const { return vec_.size(); }
@@ -902,9 +4680,9 @@ struct permutation : gen_base<permutation> {
 			return ((size() - cycles) % 2 == 0) ? +1 : -1;
 		}
 
-		// Sorts values in increasign order.
+		// Sorts values in increasign order. This is always 0, ..., n-1.
 		instance &sort() {
-			std::sort(vec_.begin(), vec_.end());
+			std::iota(vec_.begin(), vec_.end(), 0);
 			return *this;
 		}
 
@@ -944,13 +4722,39 @@ struct permutation : gen_base<permutation> {
 		std::vector<int> to_std() const { return vec_; }
 	};
 
+	// Reads an instance from `in`, and checks that it satisfies the set values.
+	// Values can be 0-based, or 1-based (then `add_1` is set).
+	instance read(reader &in) const {
+		tgen_trace_internal("permutation::read");
+		std::vector<int> vec = in.read<int>(size_);
+		bool one_based = std::find(vec.begin(), vec.end(), 0) == vec.end();
+		if (one_based)
+			for (int &value : vec)
+				--value;
+		instance inst(std::move(vec));
+		inst.add_1_ = one_based;
+		for (auto [idx, value] : sets)
+			tgen_ensure(inst[idx] == value, "read values must satisfy `set`");
+		return inst;
+	}
+
 	// Generates permutation instance.
 	instance gen() {
+		tgen_stats_internal(stats_scope_internal scope(stats::permutation);)
+		tgen_trace_internal("permutation::gen");
+		if (sets.empty()) {
+			// Shuffles directly, instead of building the set of all indices
+			// of a distinct constraint.
+			std::vector<int> perm(size_);
+			std::iota(perm.begin(), perm.end(), 0);
+			shuffle(perm.begin(), perm.end());
+			return instance(std::move(perm));
+		}
 		sequence<int> seq(size_, 0, size_ - 1);
-		seq.distinct();
+		seq.distinct().memory_resource(resource_);
 		for (auto [idx, val] : sets)
 			seq.set(idx, val);
-		return instance(seq.gen().to_std());
+		return instance(std::move(seq.gen().vec_));
 	}
 
 	// Generates permutation instance, given cycle sizes.
@@ -958,29 +4762,755 @@ struct permutation : gen_base<permutation> {
 		tgen_ensure(
 			size_ == std::accumulate(cycle_sizes.begin(), cycle_sizes.end(), 0),
 			"cycle sizes must add up to size of permutation");
+		tgen_stats_internal(stats_scope_internal scope(stats::permutation);)
+		tgen_trace_internal("permutation::gen(cycle_sizes)");
 
-		// Creates cycles.
-		std::vector<int> order(size_);
+		// Creates cycles, as consecutive ranges of a random order.
+		scratch_scope_internal scratch;
+		std::pmr::vector<int> order(
+			size_, resource_ ? resource_ : scratch_resource_internal());
 		std::iota(order.begin(), order.end(), 0);
 		shuffle(order.begin(), order.end());
-		int idx = 0;
-		std::vector<std::vector<int>> cycles;
+
+		// Retrieves permutation from cycles.
+		std::vector<int> perm(size_, -1);
+		int start = 0;
 		for (int cycle_size : cycle_sizes) {
-			cycles.emplace_back();
 			for (int i = 0; i < cycle_size; ++i)
-				cycles.back().push_back(order[idx++]);
+				perm[order[start + i]] = order[start + (i + 1) % cycle_size];
+			start += cycle_size;
 		}
 
-		// Retrieves permutation from cycles.
-		std::vector<int> perm(size_, -1);
-		for (const std::vector<int> &cycle : cycles) {
-			int cur_size = cycle.size();
-			for (int i = 0; i < cur_size; ++i)
-				perm[cycle[i]] = cycle[(i + 1) % cur_size];
+		return instance(std::move(perm));
+	}
+};
+
+/*
+ * Lazy permutation generator.
+ *
+ * Variant of `permutation` for huge permutations. An instance is a keyed
+ * pseudo-random bijection on [0, n), so it takes O(1) memory, and both a value
+ * and its preimage are computed in O(1).
+ */
+
+struct lazy_permutation : gen_base<lazy_permutation> {
+	long long size_; // Size of permutation.
+
+	// Creates generator for permutation of size 'size'.
+	lazy_permutation(long long size) : size_(size) {
+		tgen_ensure(size_ > 0, "size must be positive");
+	}
+
+	// Lazy permutation instance. Values are computed on access.
+	// Operations on an instance are not random.
+	struct instance {
+		using value_type = long long; // Value type, for templates.
+		long long size_;			  // Size of permutation.
+		feistel_internal perm_;		  // Bijection on [0, size).
+		bool inverse_ = false;		  // If represents the inverse of `perm_`.
+		bool add_1_ = false;		  // If should add 1, for printing.
+
+		// Fetches size.
+		long long size() const { return size_; }
+
+		// Computes position idx.
+		long long operator[](long long idx) const {
+			return inverse_ ? perm_.inverse(idx) : perm_(idx);
+		}
+
+		// Inverse of the permutation. Takes O(1).
+		instance &inverse() {
+			inverse_ = !inverse_;
+			return *this;
+		}
+
+		// Sets that should print values 1-based.
+		instance &add_1() {
+			add_1_ = true;
+			return *this;
+		}
+
+		// Prints in stdout, separated by spaces.
+		friend std::ostream &operator<<(std::ostream &out,
+										const instance &inst) {
+			for (long long i = 0; i < inst.size(); ++i) {
+				if (i > 0)
+					out << ' ';
+				out << inst[i] + inst.add_1_;
+			}
+			return out;
+		}
+
+		// Gets a std::vector representing the instance.
+		std::vector<long long> to_std() const {
+			std::vector<long long> vec(size_);
+			int threads = work_threads_internal(size_);
+			parallel_internal(threads, [&](int t) {
+				long long last = size_ * (t + 1) / threads;
+				for (long long idx = size_ * t / threads; idx < last; ++idx)
+					vec[idx] = (*this)[idx];
+			});
+			return vec;
+		}
+	};
+
+	// Generates lazy permutation instance.
+	instance gen() const {
+		tgen_stats_internal(stats_scope_internal scope(stats::permutation);)
+		tgen_trace_internal("lazy_permutation::gen");
+		return instance{size_, feistel_internal(size_, fill_key_internal())};
+	}
+};
+
+/************
+ *          *
+ *   TREE   *
+ *          *
+ ************/
+
+/*
+ * Tree generator.
+ *
+ * Uniformly random labeled trees are decoded from a random Prufer sequence in
+ * O(n), with a pointer to the smallest leaf instead of a heap, and rooted at a
+ * random vertex. Shapes (path, star, caterpillar, bounded depth) are built on
+ * vertices 0..n-1 and then relabeled with a random permutation. The root is a
+ * uniformly random vertex in every case.
+ */
+
+struct tree : gen_base<tree> {
+	enum class shape_internal { uniform, path, star, caterpillar, depth };
+
+	int size_;										 // Number of vertices.
+	shape_internal shape_ = shape_internal::uniform; // Shape of the tree.
+	int param_ = 0;									 // Spine, or maximum depth.
+
+	// Creates generator for labeled trees on 'size' vertices.
+	tree(int size) : size_(size) {
+		tgen_ensure(size_ > 0, "size must be positive");
+	}
+
+	tree &set_shape_internal(shape_internal shape, int param) {
+		tgen_ensure(shape_ == shape_internal::uniform,
+					"tree can only have one shape");
+		shape_ = shape, param_ = param;
+		return *this;
+	}
+
+	// Restricts trees to paths.
+	tree &path() { return set_shape_internal(shape_internal::path, 0); }
+
+	// Restricts trees to stars.
+	tree &star() { return set_shape_internal(shape_internal::star, 0); }
+
+	// Restricts trees to caterpillars: a path of 'spine' vertices, and every
+	// other vertex attached to a uniformly random vertex of the path.
+	tree &caterpillar(int spine) {
+		tgen_ensure(1 <= spine and spine <= size_,
+					"spine size must be from 1 to size");
+		return set_shape_internal(shape_internal::caterpillar, spine);
+	}
+
+	// Restricts trees to have depth at most 'depth' from the root. Every vertex
+	// is attached to a uniformly random previous vertex of depth less than
+	// 'depth' (a random recursive tree, cut at 'depth').
+	tree &max_depth(int depth) {
+		tgen_ensure(depth > 0 or size_ == 1, "depth must be positive");
+		return set_shape_internal(shape_internal::depth, depth);
+	}
+
+	// Tree instance, as the parent of each vertex.
+	// Operations on an instance are not random.
+	struct instance {
+		std::vector<int> parent_; // Parent of each vertex, -1 for the root.
+		bool add_1_ = false;	  // If should add 1, for printing.
+		bool parents_ = false;	  // If prints parents instead of edges.
+
+		instance(const std::vector<int> &parent) : parent_(parent) {
+			check_internal();
+		}
+		instance(std::vector<int> &&parent) : parent_(std::move(parent)) {
+			check_internal();
+		}
+		instance(const std::initializer_list<int> &il)
+			: instance(std::vector<int>(il.begin(), il.end())) {}
+
+		// Instance of `parent`, that is known to be a rooted tree.
+		static instance unchecked_internal(std::vector<int> &&parent) {
+			instance inst({-1});
+			inst.parent_ = std::move(parent);
+			return inst;
+		}
+
+		// Checks that `parent_` is a rooted tree.
+		void check_internal() const {
+			int n = parent_.size();
+			tgen_ensure(n > 0, "tree cannot be empty");
+			int roots = 0;
+			for (int v = 0; v < n; ++v) {
+				tgen_ensure(-1 <= parent_[v] and parent_[v] < n,
+							"parents must be from `-1` to `size-1`");
+				roots += parent_[v] == -1;
+			}
+			tgen_ensure(roots == 1, "tree must have exactly one root");
+			// 0: not visited, 1: in the current walk, 2: reaches the root.
+			std::vector<char> state(n, 0);
+			for (int v = 0; v < n; ++v) {
+				int u = v;
+				for (; u != -1 and state[u] == 0; u = parent_[u])
+					state[u] = 1;
+				tgen_ensure(u == -1 or state[u] == 2,
+							"tree cannot have cycles");
+				for (u = v; u != -1 and state[u] == 1; u = parent_[u])
+					state[u] = 2;
+			}
+		}
+
+		// Fetches number of vertices.
+		std::size_t size() const { return parent_.size(); }
+
+		// Fetches parent of vertex v (-1 for the root).
+		const int &operator[](int v) const { return parent_[v]; }
+
+		// Fetches the root.
+		int root() const {
+			return std::find(parent_.begin(), parent_.end(), -1) -
+				   parent_.begin();
+		}
+
+		// Roots the tree at vertex v, reversing the path from v to the root.
+		instance &reroot(int v) {
+			tgen_ensure(0 <= v and v < static_cast<int>(size()),
+						"vertex must be valid");
+			for (int prev = -1; v != -1;)
+				std::swap(parent_[v], prev), std::swap(v, prev);
+			return *this;
+		}
+
+		// Sets that should print vertices 1-based.
+		instance &add_1() {
+			add_1_ = true;
+			return *this;
+		}
+
+		// Sets that should print the parent array instead of the edges.
+		instance &parents() {
+			parents_ = true;
+			return *this;
+		}
+
+		// Gets the edges {v, parent of v}, in order of v.
+		std::vector<std::pair<int, int>> edges() const {
+			std::vector<std::pair<int, int>> edges;
+			edges.reserve(size() - 1);
+			for (std::size_t v = 0; v < size(); ++v)
+				if (parent_[v] != -1)
+					edges.emplace_back(v, parent_[v]);
+			return edges;
+		}
+
+		// Prints in stdout the edges "v p", one per line, or the parents (with
+		// `parents`) separated by spaces.
+		friend std::ostream &operator<<(std::ostream &out,
+										const instance &inst) {
+			writer_internal writer(out);
+			bool first = true;
+			for (std::size_t v = 0; v < inst.size(); ++v) {
+				int p = inst.parent_[v];
+				if (inst.parents_) {
+					if (v > 0)
+						writer.write(' ');
+					writer.write(static_cast<long long>(p + inst.add_1_));
+				} else if (p != -1) {
+					if (!first)
+						writer.write('\n');
+					first = false;
+					writer.write(static_cast<long long>(v + inst.add_1_));
+					writer.write(' ');
+					writer.write(static_cast<long long>(p + inst.add_1_));
+				}
+			}
+			return out;
+		}
+
+		// Gets a std::vector of the parent of each vertex.
+		std::vector<int> to_std() const { return parent_; }
+	};
+
+	// Decodes a Prufer sequence of vertices in [0, n), into the parent of each
+	// vertex in the tree rooted at n-1.
+	static std::vector<int> prufer_decode_internal(const std::vector<int> &code,
+												   int n) {
+		std::vector<int> degree(n, 1), parent(n, -1);
+		for (int v : code)
+			++degree[v];
+		int ptr = 0;
+		while (degree[ptr] != 1)
+			++ptr;
+		int leaf = ptr;
+		for (int v : code) {
+			parent[leaf] = v;
+			if (--degree[v] == 1 and v < ptr)
+				leaf = v;
+			else {
+				while (degree[++ptr] != 1)
+					;
+				leaf = ptr;
+			}
+		}
+		if (n > 1)
+			parent[leaf] = n - 1;
+		return parent;
+	}
+
+	// Generates tree instance.
+	instance gen() const {
+		tgen_stats_internal(stats_scope_internal scope(stats::tree);)
+		tgen_trace_internal("tree::gen");
+		std::vector<int> parent(size_, -1);
+		if (shape_ == shape_internal::uniform) {
+			// The decoded tree is uniform over the labels, so only its root is
+			// drawn.
+			if (size_ > 2)
+				parent = prufer_decode_internal(
+					sequence<int>(size_ - 2, 0, size_ - 1).gen().vec_, size_);
+			else if (size_ == 2)
+				parent[0] = 1;
+			instance inst = instance::unchecked_internal(std::move(parent));
+			inst.reroot(next(0, size_ - 1));
+			return inst;
+		}
+
+		switch (shape_) {
+		case shape_internal::path:
+			for (int v = 1; v < size_; ++v)
+				parent[v] = v - 1;
+			break;
+		case shape_internal::star:
+			std::fill(parent.begin() + 1, parent.end(), 0);
+			break;
+		case shape_internal::caterpillar:
+			for (int v = 1; v < size_; ++v)
+				parent[v] = v < param_ ? v - 1 : next(0, param_ - 1);
+			break;
+		default: {
+			// Previous vertices of depth less than `param_`.
+			std::vector<int> depth(size_, 0), open = {0};
+			for (int v = 1; v < size_; ++v) {
+				parent[v] = open[next<int>(0, open.size() - 1)];
+				if ((depth[v] = depth[parent[v]] + 1) < param_)
+					open.push_back(v);
+			}
+		}
+		}
+
+		// Relabels vertex v as label[v].
+		std::vector<int> label = permutation(size_).gen().vec_;
+		std::vector<int> relabeled(size_);
+		for (int v = 0; v < size_; ++v)
+			relabeled[label[v]] = parent[v] == -1 ? -1 : label[parent[v]];
+		return instance::unchecked_internal(std::move(relabeled));
+	}
+};
+
+/*************
+ *           *
+ *   GRAPH   *
+ *           *
+ *************/
+
+/*
+ * Graph generator.
+ *
+ * Simple graphs with a given number of edges. Each pair of vertices has an
+ * index (in the order of the pairs), and the edges are a uniformly random
+ * subset of the indices, drawn in O(m) with `sorted_subset_internal` and
+ * decoded in O(1), so dense graphs do not need a set of the drawn edges.
+ */
+
+struct graph : gen_base<graph> {
+	int size_;				 // Number of vertices.
+	long long edge_count_;	 // Number of edges.
+	bool directed_ = false;	 // If edges are directed.
+	bool connected_ = false; // If graphs must be (weakly) connected.
+
+	// Creates generator for simple graphs on 'size' vertices, with 'edges'
+	// edges.
+	graph(int size, long long edges) : size_(size), edge_count_(edges) {
+		tgen_ensure(size_ > 0, "size must be positive");
+		tgen_ensure(edge_count_ >= 0, "number of edges must be non-negative");
+	}
+
+	// Restricts graphs to be directed. Both (u, v) and (v, u) can be edges.
+	graph &directed() {
+		directed_ = true;
+		return *this;
+	}
+
+	// Restricts graphs to be connected (weakly, if directed).
+	graph &connected() {
+		connected_ = true;
+		return *this;
+	}
+
+	// Graph instance, as a list of edges.
+	// Operations on an instance are not random.
+	struct instance {
+		int size_;								 // Number of vertices.
+		std::vector<std::pair<int, int>> edges_; // Edges.
+		bool directed_;							 // If edges are directed.
+		bool add_1_ = false;					 // If prints 1-based.
+
+		instance(int size, const std::vector<std::pair<int, int>> &edges,
+				 bool directed = false)
+			: size_(size), edges_(edges), directed_(directed) {
+			check_internal();
+		}
+		instance(int size, std::vector<std::pair<int, int>> &&edges,
+				 bool directed = false)
+			: size_(size), edges_(std::move(edges)), directed_(directed) {
+			check_internal();
+		}
+
+		// Checks that the vertices of the edges are valid.
+		void check_internal() const {
+			tgen_ensure(size_ > 0, "graph cannot be empty");
+			for (auto [u, v] : edges_)
+				tgen_ensure(0 <= std::min(u, v) and std::max(u, v) < size_,
+							"vertices must be from `0` to `size-1`");
+		}
+
+		// Fetches number of vertices.
+		std::size_t size() const { return size_; }
+
+		// Fetches the edges.
+		const std::vector<std::pair<int, int>> &edges() const { return edges_; }
+
+		// Fetches edge idx.
+		const std::pair<int, int> &operator[](std::size_t idx) const {
+			return edges_[idx];
+		}
+
+		// Sets that should print vertices 1-based.
+		instance &add_1() {
+			add_1_ = true;
+			return *this;
+		}
+
+		// Gets the graph in compressed sparse row form: the neighbors of u are
+		// targets[offsets[u]..offsets[u+1]), in order of the edges. Undirected
+		// edges are in the neighbors of both of their vertices.
+		std::pair<std::vector<long long>, std::vector<int>> to_csr() const {
+			std::vector<long long> offsets(size_ + 1, 0);
+			for (auto [u, v] : edges_) {
+				++offsets[u + 1];
+				if (!directed_)
+					++offsets[v + 1];
+			}
+			for (int u = 0; u < size_; ++u)
+				offsets[u + 1] += offsets[u];
+			std::vector<int> targets(offsets[size_]);
+			std::vector<long long> at(offsets.begin(), offsets.end() - 1);
+			for (auto [u, v] : edges_) {
+				targets[at[u]++] = v;
+				if (!directed_)
+					targets[at[v]++] = u;
+			}
+			return {std::move(offsets), std::move(targets)};
 		}
 
-		return instance(perm);
+		// Prints in stdout the edges "u v", one per line.
+		friend std::ostream &operator<<(std::ostream &out,
+										const instance &inst) {
+			writer_internal writer(out);
+			for (std::size_t i = 0; i < inst.edges_.size(); ++i) {
+				if (i > 0)
+					writer.write('\n');
+				writer.write(
+					static_cast<long long>(inst.edges_[i].first + inst.add_1_));
+				writer.write(' ');
+				writer.write(static_cast<long long>(inst.edges_[i].second +
+													inst.add_1_));
+			}
+			return out;
+		}
+
+		// Gets a std::vector of the edges.
+		std::vector<std::pair<int, int>> to_std() const { return edges_; }
+	};
+
+	// Number of pairs of vertices that can be edges.
+	long long pair_count_internal() const {
+		long long pairs = static_cast<long long>(size_) * (size_ - 1);
+		return directed_ ? pairs : pairs / 2;
+	}
+
+	// Index of a pair of vertices. Directed pairs (u, v) are in order of u and
+	// then v; undirected pairs {u, v} with u < v are in order of v and then u.
+	long long index_internal(int u, int v) const {
+		if (directed_)
+			return static_cast<long long>(u) * (size_ - 1) + v - (v > u);
+		if (u > v)
+			std::swap(u, v);
+		return static_cast<long long>(v) * (v - 1) / 2 + u;
+	}
+
+	// Pair of vertices of an index, in O(1).
+	std::pair<int, int> pair_internal(long long idx) const {
+		if (directed_) {
+			int u = idx / (size_ - 1), v = idx % (size_ - 1);
+			return {u, v + (v >= u)};
+		}
+		long long v = (1 + std::sqrt(1 + 8.0 * idx)) / 2;
+		while (v * (v - 1) / 2 > idx)
+			--v;
+		while ((v + 1) * v / 2 <= idx)
+			++v;
+		return {idx - v * (v - 1) / 2, v};
+	}
+
+	// Generates graph instance.
+	instance gen() const {
+		tgen_stats_internal(stats_scope_internal scope(stats::graph);)
+		tgen_trace_internal("graph::gen");
+		long long pairs = pair_count_internal();
+		if (edge_count_ > pairs)
+			contradiction_error_internal(
+				"graph", "tried to generate " + std::to_string(edge_count_) +
+							 " edges, but the maximum is " +
+							 std::to_string(pairs));
+		if (connected_ and edge_count_ < size_ - 1)
+			contradiction_error_internal(
+				"graph", "tried to generate a connected graph with " +
+							 std::to_string(edge_count_) +
+							 " edges, but the minimum is " +
+							 std::to_string(size_ - 1));
+
+		// A connected graph has the edges of a random spanning tree, and the
+		// others are drawn from the remaining pairs. Arcs of the tree of a
+		// directed graph are randomly oriented.
+		std::vector<std::pair<int, int>> edges;
+		edges.reserve(edge_count_);
+		std::vector<long long> tree_idx;
+		if (connected_) {
+			tree::instance spanning = tree(size_).gen();
+			uint64_t bits = 0;
+			for (int v = 0, arcs = 0; v < size_; ++v)
+				if (spanning[v] != -1) {
+					std::pair<int, int> edge(v, spanning[v]);
+					if (directed_) {
+						if (arcs++ % 64 == 0)
+							bits = next<uint64_t>(0, UINT64_MAX);
+						if (bits & 1)
+							std::swap(edge.first, edge.second);
+						bits >>= 1;
+					}
+					edges.push_back(edge);
+					tree_idx.push_back(index_internal(edge.first, edge.second));
+				}
+			std::sort(tree_idx.begin(), tree_idx.end());
+		}
+
+		// The rank of an index among the pairs not in the tree is shifted by
+		// the number of tree indices up to it.
+		auto tree_it = tree_idx.begin();
+		auto select = [&](long long rank) {
+			long long idx = rank + (tree_it - tree_idx.begin());
+			while (tree_it != tree_idx.end() and *tree_it <= idx)
+				++tree_it, ++idx;
+			edges.push_back(pair_internal(idx));
+		};
+		sorted_subset_internal(pairs - tree_idx.size(),
+							   edge_count_ - tree_idx.size(), select);
+
+		// Random order of the edges, and of the vertices of undirected edges.
+		shuffle(edges.begin(), edges.end());
+		if (!directed_)
+			for (std::size_t i = 0; i < edges.size(); i += 64) {
+				uint64_t bits = next<uint64_t>(0, UINT64_MAX);
+				for (std::size_t j = i; j < std::min(i + 64, edges.size());
+					 ++j, bits >>= 1)
+					if (bits & 1)
+						std::swap(edges[j].first, edges[j].second);
+			}
+		return instance(size_, std::move(edges), directed_);
+	}
+};
+
+/*****************
+ *               *
+ *   MULTITEST   *
+ *               *
+ *****************/
+
+/*
+ * Multi-test files.
+ *
+ * Files with T cases and a budget for the sum of their sizes. The budget is
+ * split into case sizes, and runs of consecutive cases are printed, each from
+ * its own random stream, on several threads into per-run buffers. Batches of
+ * runs are double-buffered: a batch is generated while the previous one is
+ * written, so generation and output overlap. The file only depends on the
+ * seed.
+ */
+
+struct multitest {
+	int count_;				   // Number of cases.
+	long long total_;		   // Sum of the sizes of the cases.
+	long long min_size_ = 1;   // Minimum size of a case.
+	enum class split_internal { random, equal, skewed };
+	split_internal split_ = split_internal::random; // How sizes are split.
+
+	// Creates multi-test of count cases, with sizes that add up to total.
+	multitest(int count, long long total) : count_(count), total_(total) {
+		tgen_ensure(count_ > 0, "number of cases must be positive");
+		tgen_ensure(total_ >= 0, "total size must be non-negative");
+	}
+
+	// Sets the minimum size of a case.
+	multitest &min_size(long long size) {
+		tgen_ensure(size >= 0, "minimum size must be non-negative");
+		min_size_ = size;
+		return *this;
+	}
+
+	// Splits the total into sizes as equal as possible.
+	multitest &equal() {
+		split_ = split_internal::equal;
+		return *this;
+	}
+
+	// Splits the total into one large case, and cases of the minimum size.
+	multitest &skewed() {
+		split_ = split_internal::skewed;
+		return *this;
+	}
+
+	// Draws the sizes of the cases. By default, uniformly among the ways to
+	// split the total into sizes of at least the minimum size.
+	std::vector<long long> sizes() const {
+		tgen_ensure(min_size_ <= total_ / count_,
+					"total size must fit the minimum size of every case");
+		long long free = total_ - min_size_ * count_;
+		std::vector<long long> sizes(count_, min_size_);
+		if (split_ == split_internal::random) {
+			// Sizes are the gaps between count-1 separators, among
+			// free + count - 1 positions (stars and bars).
+			long long last = -1;
+			int idx = 0;
+			sorted_subset_internal(free + count_ - 1, count_ - 1,
+								   [&](unsigned long long pos) {
+									   long long at = pos;
+									   sizes[idx++] += at - last - 1;
+									   last = at;
+								   });
+			sizes.back() += free + count_ - 1 - last - 1;
+		} else if (split_ == split_internal::equal) {
+			std::vector<int> order(count_);
+			std::iota(order.begin(), order.end(), 0);
+			shuffle(order.begin(), order.end());
+			for (int i = 0; i < count_; ++i)
+				sizes[order[i]] += free / count_ + (i < free % count_);
+		} else {
+			sizes[next(0, count_ - 1)] += free;
+		}
+		return sizes;
+	}
+
+	// Prints the number of cases, and then every case with
+	// `print_case(out, size)`, followed by a newline. Runs of consecutive cases
+	// with about 4096 values in total are printed concurrently, each with its
+	// own random stream.
+	template <typename F>
+	void print(F print_case, std::ostream &out = std::cout) const {
+		tgen_trace_internal("multitest::print");
+		std::vector<long long> sizes = this->sizes();
+		uint64_t key = fill_key_internal();
+		rng_guard_internal guard;
+		out << count_ << '\n';
+
+		// Ends of the runs of cases, with at least 4096 values (counting a
+		// newline per case) each, except the last one.
+		std::vector<int> run_end;
+		long long values = 0;
+		for (int i = 0; i < count_; ++i)
+			if ((values += sizes[i] + 1) >= 1 << 12 or i + 1 == count_)
+				run_end.push_back(i + 1), values = 0;
+		int runs = run_end.size();
+
+		// First error of a run, rethrown before the run would be written.
+		std::mutex mutex;
+		int error_run = runs;
+		std::exception_ptr error;
+
+		// Prints the runs in [first, last) into buffers.
+		auto generate = [&](int first, int last,
+							std::vector<std::string> &buffers) {
+			buffers.assign(last - first, "");
+			std::atomic<int> next_run = first;
+			parallel_internal(
+				std::min(thread_count_internal(), last - first), [&](int) {
+					for (int run; (run = next_run++) < last;) {
+						seed_stream_internal(key, run);
+						try {
+							std::ostringstream run_out;
+							for (int i = run > 0 ? run_end[run - 1] : 0;
+								 i < run_end[run]; ++i) {
+								print_case(run_out, sizes[i]);
+								run_out << '\n';
+							}
+							buffers[run - first] = run_out.str();
+						} catch (...) {
+							std::lock_guard lock(mutex);
+							if (run < error_run) {
+								error_run = run;
+								error = std::current_exception();
+							}
+						}
+					}
+				});
+		};
+
+		// Batches of runs have about a block of values per thread.
+		long long batch_size = fill_block_internal * thread_count_internal();
+		auto batch_end = [&](int first) {
+			long long batch_values = 0;
+			while (first < runs and batch_values < batch_size) {
+				int begin = first > 0 ? run_end[first - 1] : 0;
+				batch_values += std::accumulate(
+					sizes.begin() + begin, sizes.begin() + run_end[first], 0LL);
+				++first;
+			}
+			return first;
+		};
+
+		// Writes a batch while the next one is generated.
+		std::vector<std::string> current, ahead;
+		int first = 0, last = batch_end(0);
+		generate(first, last, current);
+		while (first < runs) {
+			int ahead_last = batch_end(last);
+			std::thread ahead_thread;
+			if (last < runs)
+				ahead_thread = std::thread(generate, last, ahead_last,
+										   std::ref(ahead));
+			int failed_run;
+			{
+				std::lock_guard lock(mutex);
+				failed_run = error_run;
+			}
+			for (int run = first; run < std::min(last, failed_run); ++run)
+				out.write(current[run - first].data(),
+						  current[run - first].size());
+			if (ahead_thread.joinable())
+				ahead_thread.join();
+			if (failed_run < last)
+				std::rethrow_exception(error);
+			std::swap(current, ahead);
+			first = last, last = ahead_last;
+		}
 	}
 };
 
 }; // namespace tgen
+
@@ -3,8 +3,19 @@
 #include "tgen.h"
 
 #include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <thread>
 #include <vector>
 
+// Counts allocations in `tgen::stats`, if the tests are built with
+// `TGEN_STATS`. Only this translation unit can do it.
+tgen_count_allocations()
+
 #define EXPECT_THROW_TGEN_PREFIX(stmt, prefix)                                 \
 	EXPECT_THROW(                                                              \
 		{                                                                      \
@@ -43,6 +54,23 @@ TEST(general_test, next_invalid_range) {
 							 "range for `next` bust be valid");
 }
 
+TEST(general_test, next_on_user_thread) {
+	// Threads of the user draw from the state seeded by `register_gen`.
+	auto draw_on_thread = [](const char *seed) {
+		auto argv = get_argv({"./executable", seed});
+		tgen::register_gen(argv.size() - 1, argv.data());
+		long long value;
+		std::thread([&] { value = tgen::next(0LL, (long long)1e18); }).join();
+		return value;
+	};
+	auto argv = get_argv({"./executable", "1"});
+	tgen::register_gen(argv.size() - 1, argv.data());
+	long long expected = tgen::next(0LL, (long long)1e18);
+
+	EXPECT_EQ(draw_on_thread("1"), expected);
+	EXPECT_NE(draw_on_thread("2"), expected);
+}
+
 TEST(general_test, shuffle_check_values) {
 	auto argv = get_argv({"./executable"});
 	tgen::register_gen(argv.size() - 1, argv.data());
@@ -105,3 +133,206 @@ TEST(general_test, choose_check_subsequence) {
 		EXPECT_TRUE(subseq_it == subseq.end());
 	}
 }
+
+TEST(general_test, stats_dump) {
+	tgen::stats::reset();
+	tgen::stats::rng_draws[tgen::stats::shuffle] = 5;
+	tgen::stats::gen_until_attempts = 10;
+	tgen::stats::gen_until_accepted = 1;
+	tgen::stats::sequence_gen[tgen::stats::set_bit |
+							  tgen::stats::distinct_bit] = 2;
+
+	std::ostringstream out;
+	tgen::stats::dump(out);
+	EXPECT_EQ(out.str(), "tgen stats:\n"
+						 "  rng draws:\n"
+						 "    shuffle: 5\n"
+						 "  gen_until: 10 attempts, 1 accepted (acceptance "
+						 "rate 10%)\n"
+						 "  sequence::gen calls:\n"
+						 "    set+distinct: 2\n"
+						 "  generate_distinct_values: 0 calls, 0 forbidden "
+						 "values\n"
+						 "  allocations: 0 (0 bytes)\n");
+	tgen::stats::reset();
+}
+
+TEST(general_test, stats_counted_new) {
+	tgen::stats::reset();
+	void *ptr = tgen::stats::counted_new_internal(100);
+	EXPECT_NE(ptr, nullptr);
+	EXPECT_EQ(tgen::stats::allocations, 1);
+	EXPECT_EQ(tgen::stats::bytes_allocated, 100);
+	tgen::stats::counted_delete_internal(ptr);
+	tgen::stats::reset();
+}
+
+#ifdef TGEN_STATS
+TEST(general_test, stats_counting) {
+	auto argv = get_argv({"./executable"});
+	tgen::register_gen(argv.size() - 1, argv.data());
+
+	tgen::stats::reset();
+	tgen::sequence<int>(10, 1, 100).gen();
+	tgen::sequence<int>(10, 1, 100).set(0, 1).distinct().gen();
+	auto *vec = new std::vector<int>(1000);
+	delete vec;
+
+	EXPECT_EQ(tgen::stats::rng_draws[tgen::stats::user], 0);
+	EXPECT_GE(tgen::stats::rng_draws[tgen::stats::sequence], 10);
+	EXPECT_EQ(tgen::stats::sequence_gen[0], 1);
+	EXPECT_EQ(
+		tgen::stats::sequence_gen[tgen::stats::set_bit |
+								  tgen::stats::distinct_bit],
+		1);
+	EXPECT_GE(tgen::stats::allocations, 2);
+	EXPECT_GE(tgen::stats::bytes_allocated, 1000 * sizeof(int));
+	tgen::stats::reset();
+}
+#endif
+
+TEST(general_test, trace_write) {
+	tgen::trace_events_internal.clear();
+	{ tgen::trace_scope_internal scope("phase"); }
+	tgen::trace_events_internal[0].start_ns = 1234567;
+	tgen::trace_events_internal[0].duration_ns = 89;
+
+	std::ostringstream out;
+	tgen::trace_write_internal(out);
+	EXPECT_EQ(out.str(), "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n"
+						 "{\"name\": \"phase\", \"cat\": \"tgen\", \"ph\": "
+						 "\"X\", \"pid\": 0, \"tid\": 0, \"ts\": 1234.567, "
+						 "\"dur\": 0.089}\n"
+						 "]}\n");
+	tgen::trace_events_internal.clear();
+}
+
+TEST(general_test, binary_instances) {
+	auto argv = get_argv({"./executable"});
+	tgen::register_gen(argv.size() - 1, argv.data());
+	std::string path =
+		(std::filesystem::temp_directory_path() / "tgen_binary_test.bin")
+			.string();
+
+	// Raw and varint values round-trip, and print as the instance.
+	auto seq = tgen::sequence<long long>(100000, -1e18, 1e18).gen();
+	for (auto encoding :
+		 {tgen::binary_encoding::raw, tgen::binary_encoding::varint}) {
+		{
+			std::ofstream out(path, std::ios::binary);
+			tgen::write_binary(out, seq, encoding);
+		}
+		tgen::binary_view<long long> view(path);
+		EXPECT_EQ(view.to_std(), seq.to_std());
+		std::ostringstream text, view_text;
+		text << seq, view_text << view;
+		EXPECT_EQ(view_text.str(), text.str());
+	}
+
+	// Keeps `add_1`.
+	auto perm = tgen::permutation(1000).gen().add_1();
+	{
+		std::ofstream out(path, std::ios::binary);
+		tgen::write_binary(out, perm, tgen::binary_encoding::varint);
+	}
+	std::ostringstream text, view_text;
+	text << perm, view_text << tgen::binary_view<int>(path);
+	EXPECT_EQ(view_text.str(), text.str());
+
+	auto reals = tgen::sequence<double>(1000, 0, 1).gen();
+	{
+		std::ofstream out(path, std::ios::binary);
+		tgen::write_binary(out, reals);
+	}
+	EXPECT_EQ(tgen::binary_view<double>(path).to_std(), reals.to_std());
+	EXPECT_THROW_TGEN_PREFIX(tgen::binary_view<float>(path).size(),
+							 "invalid binary instance");
+
+	// Corrupted values.
+	{
+		std::fstream file(path,
+						  std::ios::binary | std::ios::in | std::ios::out);
+		file.seekp(100);
+		file.put('x');
+	}
+	EXPECT_THROW_TGEN_PREFIX(tgen::binary_view<double>(path).size(),
+							 "invalid binary instance");
+	std::filesystem::remove(path);
+	EXPECT_THROW_TGEN_PREFIX(tgen::binary_view<double>(path).size(),
+							 "could not open");
+}
+
+TEST(general_test, multitest) {
+	auto argv = get_argv({"./executable"});
+	tgen::register_gen(argv.size() - 1, argv.data());
+
+	EXPECT_THROW_TGEN_PREFIX(tgen::multitest(0, 10),
+							 "number of cases must be positive");
+	EXPECT_THROW_TGEN_PREFIX(tgen::multitest(3, -1),
+							 "total size must be non-negative");
+	EXPECT_THROW_TGEN_PREFIX(tgen::multitest(3, 10).min_size(4).sizes(),
+							 "total size must fit the minimum size of every "
+							 "case");
+
+	// Random splits are uniform.
+	std::map<std::vector<long long>, int> count;
+	for (int i = 0; i < 3000; ++i) {
+		auto sizes = tgen::multitest(2, 4).sizes();
+		++count[sizes];
+	}
+	EXPECT_EQ(count.size(), 3);
+	for (auto [sizes, cnt] : count)
+		EXPECT_NEAR(cnt, 1000, 150);
+
+	auto sizes = tgen::multitest(1000, 200000).min_size(5).sizes();
+	EXPECT_EQ(std::accumulate(sizes.begin(), sizes.end(), 0LL), 200000);
+	EXPECT_EQ(*std::min_element(sizes.begin(), sizes.end()), 5);
+	sizes = tgen::multitest(7, 100).equal().sizes();
+	EXPECT_EQ(*std::max_element(sizes.begin(), sizes.end()), 15);
+	EXPECT_EQ(*std::min_element(sizes.begin(), sizes.end()), 14);
+	sizes = tgen::multitest(5, 100).min_size(2).skewed().sizes();
+	std::sort(sizes.begin(), sizes.end());
+	EXPECT_EQ(sizes, std::vector<long long>({2, 2, 2, 2, 92}));
+
+	// Output does not depend on the number of threads, and errors of cases
+	// are propagated.
+	auto print_case = [](std::ostream &out, long long size) {
+		out << size << '\n' << tgen::sequence<int>(size, 1, 1e9).gen();
+	};
+	std::vector<std::string> outputs;
+	for (const char *threads : {"--tgen-threads=1", "--tgen-threads=3"}) {
+		auto thread_argv = get_argv({"./executable", threads});
+		tgen::register_gen(thread_argv.size() - 1, thread_argv.data());
+		std::ostringstream out;
+		tgen::multitest(100, 300000).print(print_case, out);
+		outputs.push_back(out.str());
+		outputs.push_back(std::to_string(tgen::next(0, 1000000)));
+
+		EXPECT_THROW_TGEN_PREFIX(
+			tgen::multitest(10, 300000).skewed().print(
+				[](std::ostream &, long long size) {
+					if (size > 1)
+						throw std::runtime_error("tgen: large case");
+				},
+				out),
+			"large case");
+	}
+	EXPECT_EQ(outputs[0], outputs[2]);
+	EXPECT_EQ(outputs[1], outputs[3]);
+	std::istringstream in(outputs[0]);
+	int cases;
+	long long total = 0;
+	in >> cases;
+	for (int i = 0; i < cases; ++i) {
+		long long size;
+		in >> size;
+		total += size;
+		for (long long j = 0; j < size; ++j) {
+			int value;
+			in >> value;
+		}
+	}
+	EXPECT_EQ(cases, 100);
+	EXPECT_EQ(total, 300000);
+	EXPECT_TRUE(in >> std::ws and in.eof());
+}
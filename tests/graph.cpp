@@ -0,0 +1,216 @@
+#include <gtest/gtest.h>
+
+#include "tgen.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <numeric>
+#include <set>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#define EXPECT_THROW_TGEN_PREFIX(stmt, prefix)                                 \
+	EXPECT_THROW(                                                              \
+		{                                                                      \
+			try {                                                              \
+				stmt;                                                          \
+				FAIL() << "Expected std::runtime_error, but no error ocurred"; \
+			} catch (const std::runtime_error &e) {                            \
+				std::string msg = e.what();                                    \
+				std::string tgen_pref = std::string("tgen: ") + prefix;        \
+				EXPECT_TRUE(msg.rfind(tgen_pref, 0) == 0)                      \
+					<< "Expected message to start with: \"" << tgen_pref       \
+					<< "\"\n"                                                  \
+					<< "Actual message: \"" << msg << "\"";                    \
+				throw e;                                                       \
+			}                                                                  \
+		},                                                                     \
+		std::runtime_error)
+
+inline std::vector<char *> get_argv(std::initializer_list<const char *> list) {
+	std::vector<char *> v;
+	for (auto s : list)
+		v.push_back(const_cast<char *>(s));
+	v.push_back(nullptr);
+	return v;
+}
+
+// If the undirected graph is connected.
+bool is_connected(const tgen::graph::instance &inst) {
+	std::vector<int> root(inst.size());
+	std::iota(root.begin(), root.end(), 0);
+	auto find = [&](int v) {
+		while (root[v] != v)
+			v = root[v] = root[root[v]];
+		return v;
+	};
+	int components = inst.size();
+	for (auto [u, v] : inst.edges())
+		if (find(u) != find(v))
+			root[find(u)] = find(v), --components;
+	return components == 1;
+}
+
+// Sorted edges, with u < v if undirected.
+std::vector<std::pair<int, int>> sorted_edges(const tgen::graph::instance &inst,
+											  bool directed) {
+	auto edges = inst.to_std();
+	if (!directed)
+		for (auto &[u, v] : edges)
+			if (u > v)
+				std::swap(u, v);
+	std::sort(edges.begin(), edges.end());
+	return edges;
+}
+
+TEST(graph_test, constructor) {
+	auto argv = get_argv({"./executable"});
+	tgen::register_gen(argv.size() - 1, argv.data());
+
+	EXPECT_THROW_TGEN_PREFIX(tgen::graph(0, 0), "size must be positive");
+	EXPECT_THROW_TGEN_PREFIX(tgen::graph(5, -1),
+							 "number of edges must be non-negative");
+	EXPECT_THROW_TGEN_PREFIX(
+		tgen::graph(5, 11).gen(),
+		"invalid graph (contradicting constraints): tried to generate 11 "
+		"edges, but the maximum is 10");
+	EXPECT_THROW_TGEN_PREFIX(tgen::graph(5, 21).directed().gen(),
+							 "invalid graph (contradicting constraints)");
+	EXPECT_THROW_TGEN_PREFIX(
+		tgen::graph(5, 3).connected().gen(),
+		"invalid graph (contradicting constraints): tried to generate a "
+		"connected graph with 3 edges, but the minimum is 4");
+}
+
+TEST(graph_test, pair_index) {
+	for (bool directed : {false, true}) {
+		tgen::graph gen(30, 0);
+		if (directed)
+			gen.directed();
+		long long idx = 0;
+		for (int u = 0; u < 30; ++u)
+			for (int v = 0; v < 30; ++v)
+				if (u != v and (directed or u < v)) {
+					long long i = gen.index_internal(directed ? u : v,
+													 directed ? v : u);
+					EXPECT_EQ(gen.pair_internal(i), std::make_pair(u, v));
+					++idx;
+				}
+		EXPECT_EQ(gen.pair_count_internal(), idx);
+	}
+
+	// Large indices decode exactly.
+	tgen::graph gen(2000000000, 0);
+	std::vector<std::pair<int, int>> pairs = {{0, 1},
+											  {1999999998, 1999999999},
+											  {12345, 1999999999},
+											  {4, 77777},
+											  {1234567890, 1234567891}};
+	for (auto [u, v] : pairs)
+		EXPECT_EQ(gen.pair_internal(gen.index_internal(u, v)),
+				  std::make_pair(u, v));
+}
+
+TEST(graph_test, gen) {
+	auto argv = get_argv({"./executable"});
+	tgen::register_gen(argv.size() - 1, argv.data());
+
+	// The C(6, 3) undirected graphs on 4 vertices with 3 edges, and the
+	// C(6, 2) directed graphs on 3 vertices with 2 edges, are equally likely.
+	for (bool directed : {false, true}) {
+		std::map<std::vector<std::pair<int, int>>, int> count;
+		const int samples = 20000;
+		for (int i = 0; i < samples; ++i) {
+			tgen::graph gen = directed ? tgen::graph(3, 2).directed()
+									   : tgen::graph(4, 3);
+			++count[sorted_edges(gen.gen(), directed)];
+		}
+		int graphs = directed ? 15 : 20;
+		EXPECT_EQ(count.size(), graphs);
+		for (auto [edges, cnt] : count)
+			EXPECT_NEAR(cnt, 1.0 * samples / graphs,
+						5 * std::sqrt(1.0 * samples / graphs));
+	}
+
+	// Dense graphs are simple.
+	for (bool directed : {false, true}) {
+		tgen::graph gen = tgen::graph(200, 19000);
+		if (directed)
+			gen.directed();
+		auto edges = sorted_edges(gen.gen(), directed);
+		EXPECT_EQ(edges.size(), 19000);
+		EXPECT_EQ(std::unique(edges.begin(), edges.end()), edges.end());
+		for (auto [u, v] : edges)
+			EXPECT_NE(u, v);
+	}
+	EXPECT_EQ(tgen::graph(1, 0).gen().edges().size(), 0);
+	std::vector<std::pair<int, int>> complete = {{0, 1}, {0, 2}, {1, 2}};
+	EXPECT_EQ(sorted_edges(tgen::graph(3, 3).gen(), false), complete);
+}
+
+TEST(graph_test, gen_connected) {
+	auto argv = get_argv({"./executable"});
+	tgen::register_gen(argv.size() - 1, argv.data());
+
+	for (int i = 0; i < 20; ++i) {
+		EXPECT_TRUE(is_connected(tgen::graph(50, 49).connected().gen()));
+		auto edges =
+			sorted_edges(tgen::graph(50, 100).connected().gen(), false);
+		EXPECT_EQ(std::unique(edges.begin(), edges.end()), edges.end());
+		EXPECT_TRUE(
+			is_connected(tgen::graph(50, 60).connected().directed().gen()));
+	}
+}
+
+TEST(graph_test, gen_threads) {
+	// Output does not depend on the number of threads.
+	std::vector<std::vector<std::pair<int, int>>> graphs;
+	for (const char *threads : {"--tgen-threads=1", "--tgen-threads=3"}) {
+		auto argv = get_argv({"./executable", threads});
+		tgen::register_gen(argv.size() - 1, argv.data());
+		graphs.push_back(
+			tgen::graph(200000, 300000).connected().gen().to_std());
+	}
+	EXPECT_EQ(graphs[0], graphs[1]);
+}
+
+TEST(graph_test, gen_connected_directed) {
+	auto argv = get_argv({"./executable"});
+	tgen::register_gen(argv.size() - 1, argv.data());
+
+	// The 12 weakly connected directed graphs on 3 vertices with 2 edges (3
+	// spanning trees, each with 4 orientations) are all generated, and equally
+	// likely.
+	std::map<std::vector<std::pair<int, int>>, int> count;
+	const int samples = 12000;
+	for (int i = 0; i < samples; ++i) {
+		auto inst = tgen::graph(3, 2).directed().connected().gen();
+		EXPECT_TRUE(is_connected(inst));
+		++count[sorted_edges(inst, true)];
+	}
+	EXPECT_EQ(count.size(), 12);
+	for (auto [edges, cnt] : count)
+		EXPECT_NEAR(cnt, samples / 12.0, 5 * std::sqrt(samples / 12.0));
+}
+
+TEST(graph_test, instance) {
+	EXPECT_THROW_TGEN_PREFIX(tgen::graph::instance(3, {{0, 3}}),
+							 "vertices must be from `0` to `size-1`");
+
+	tgen::graph::instance inst(4, {{0, 1}, {2, 1}, {3, 0}});
+	std::stringstream out;
+	out << inst.add_1();
+	EXPECT_EQ(out.str(), "1 2\n3 2\n4 1");
+
+	auto [offsets, targets] = inst.to_csr();
+	EXPECT_EQ(offsets, std::vector<long long>({0, 2, 4, 5, 6}));
+	EXPECT_EQ(targets, std::vector<int>({1, 3, 0, 2, 1, 0}));
+
+	tgen::graph::instance directed(3, {{0, 1}, {2, 1}, {0, 2}}, true);
+	std::tie(offsets, targets) = directed.to_csr();
+	EXPECT_EQ(offsets, std::vector<long long>({0, 2, 2, 3}));
+	EXPECT_EQ(targets, std::vector<int>({1, 2, 1}));
+}
@@ -2,6 +2,10 @@
 
 #include "tgen.h"
 
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+
 #define EXPECT_THROW_TGEN_PREFIX(stmt, prefix)                                 \
 	EXPECT_THROW(                                                              \
 		{                                                                      \
@@ -154,3 +158,116 @@ TEST(opts_test, opt_positional) {
 
 	EXPECT_EQ(tgen::opt<int>(0), -10);
 }
+
+TEST(opts_test, cache_key) {
+	auto argv_1 = get_argv({"./executable", "-n", "10"});
+	auto argv_2 = get_argv({"./other", "-n", "10"});
+	auto argv_3 = get_argv({"./executable", "-n", "1", "0"});
+
+	auto key_1 = tgen::cache_key_internal(argv_1.size() - 1, argv_1.data());
+	auto key_2 = tgen::cache_key_internal(argv_2.size() - 1, argv_2.data());
+	auto key_3 = tgen::cache_key_internal(argv_3.size() - 1, argv_3.data());
+
+	ASSERT_TRUE(key_1 and key_2 and key_3);
+	EXPECT_EQ(key_1->size(), 16);
+	// The executable name is ignored, as in the seed.
+	EXPECT_EQ(*key_1, *key_2);
+	EXPECT_NE(*key_1, *key_3);
+}
+
+TEST(opts_test, cache_evict) {
+	namespace fs = std::filesystem;
+	fs::path dir = fs::temp_directory_path() / "tgen_cache_evict_test";
+	fs::remove_all(dir);
+	fs::create_directories(dir);
+
+	auto now = fs::file_time_type::clock::now();
+	auto name = [](int i) { return std::string(15, '0') + std::to_string(i); };
+	for (int i = 0; i < 4; ++i) {
+		std::ofstream(dir / name(i)) << std::string(100, 'a');
+		fs::last_write_time(dir / name(i),
+							now - std::chrono::seconds(10 * (4 - i)));
+	}
+	// Entry being written by another run, and a file not from the cache.
+	for (std::string other : {name(0) + ".tmp123", std::string("notes")}) {
+		std::ofstream(dir / other) << std::string(100, 'a');
+		fs::last_write_time(dir / other, now - std::chrono::seconds(100));
+	}
+
+	tgen::cache_evict_internal(dir, 250);
+
+	// The two least recently used entries are evicted.
+	EXPECT_FALSE(fs::exists(dir / name(0)));
+	EXPECT_FALSE(fs::exists(dir / name(1)));
+	EXPECT_TRUE(fs::exists(dir / name(2)));
+	EXPECT_TRUE(fs::exists(dir / name(3)));
+	EXPECT_TRUE(fs::exists(dir / (name(0) + ".tmp123")));
+	EXPECT_TRUE(fs::exists(dir / "notes"));
+
+	fs::remove_all(dir);
+}
+
+TEST(opts_test, cache_size_invalid) {
+	EXPECT_EQ(tgen::cache_size_internal(nullptr), 1ULL << 30);
+	EXPECT_EQ(tgen::cache_size_internal("1000"), 1000);
+	for (const char *size : {"", "1GB", "-1", "99999999999999999999999"})
+		EXPECT_THROW_TGEN_PREFIX(
+			tgen::cache_size_internal(size),
+			"TGEN_CACHE_SIZE must be a non-negative integer");
+}
+
+TEST(opts_test, cache_miss_then_hit) {
+	namespace fs = std::filesystem;
+	fs::path dir = fs::temp_directory_path() / "tgen_cache_hit_test";
+	fs::path out = fs::temp_directory_path() / "tgen_cache_hit_test.out";
+	fs::remove_all(dir);
+	auto argv = get_argv({"./executable", "-n", "cache_miss_then_hit"});
+
+	// Runs a generator printing `output` in a child process, with its stdout
+	// in `out`, and returns what it printed.
+	auto run = [&](const std::string &output, bool commit, int code) {
+		EXPECT_EXIT(
+			{
+				std::freopen(out.c_str(), "w", stdout);
+				setenv("TGEN_CACHE_DIR", dir.c_str(), 1);
+				tgen::register_gen(argv.size() - 1, argv.data());
+				std::cout << output;
+				if (commit)
+					tgen::commit_cache();
+				std::exit(code);
+			},
+			testing::ExitedWithCode(code), "");
+		std::ifstream file(out);
+		return std::string(std::istreambuf_iterator<char>(file), {});
+	};
+
+	// A failed run is not cached.
+	EXPECT_EQ(run("failed", false, 1), "failed");
+	EXPECT_EQ(run("first", true, 0), "first");
+	// Hit: the cached output is printed, and the generator exits with 0.
+	EXPECT_EQ(run("second", true, 0), "first");
+
+	fs::remove_all(dir);
+	fs::remove(out);
+}
+
+TEST(opts_test, reserved_opts) {
+	auto argv = get_argv({"./executable", "-n", "10", "--tgen-stats"});
+	tgen::register_gen(argv.size() - 1, argv.data());
+	int value = tgen::next(0, 1000000);
+
+	EXPECT_EQ(tgen::opt<int>("n"), 10);
+	EXPECT_FALSE(tgen::has_opt("tgen-stats"));
+
+	// Reserved opts do not change the seed.
+	auto argv_plain = get_argv({"./executable", "-n", "10"});
+	tgen::register_gen(argv_plain.size() - 1, argv_plain.data());
+	EXPECT_EQ(tgen::next(0, 1000000), value);
+}
+
+TEST(opts_test, reserved_opts_unknown) {
+	auto argv = get_argv({"./executable", "--tgen-unknown"});
+
+	EXPECT_THROW_TGEN_PREFIX(tgen::register_gen(argv.size() - 1, argv.data()),
+							 "unknown tgen opt (--tgen-unknown)");
+}
@@ -0,0 +1,149 @@
+#include <gtest/gtest.h>
+
+#include "tgen.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#define EXPECT_THROW_TGEN_PREFIX(stmt, prefix)                                 \
+	EXPECT_THROW(                                                              \
+		{                                                                      \
+			try {                                                              \
+				stmt;                                                          \
+				FAIL() << "Expected std::runtime_error, but no error ocurred"; \
+			} catch (const std::runtime_error &e) {                            \
+				std::string msg = e.what();                                    \
+				std::string tgen_pref = std::string("tgen: ") + prefix;        \
+				EXPECT_TRUE(msg.rfind(tgen_pref, 0) == 0)                      \
+					<< "Expected message to start with: \"" << tgen_pref       \
+					<< "\"\n"                                                  \
+					<< "Actual message: \"" << msg << "\"";                    \
+				throw e;                                                       \
+			}                                                                  \
+		},                                                                     \
+		std::runtime_error)
+
+inline std::vector<char *> get_argv(std::initializer_list<const char *> list) {
+	std::vector<char *> v;
+	for (auto s : list)
+		v.push_back(const_cast<char *>(s));
+	v.push_back(nullptr);
+	return v;
+}
+
+// Counts of each partition of `gen`, that must be `classes` equally likely
+// partitions of `sum`.
+void expect_uniform(tgen::partition gen, int sum, int classes) {
+	std::map<std::vector<int>, int> count;
+	const int samples = 300 * classes;
+	for (int i = 0; i < samples; ++i) {
+		std::vector<int> parts = gen.gen().to_std();
+		EXPECT_TRUE(std::is_sorted(parts.rbegin(), parts.rend()));
+		EXPECT_EQ(std::accumulate(parts.begin(), parts.end(), 0), sum);
+		++count[parts];
+	}
+	EXPECT_EQ(count.size(), classes);
+	for (auto [parts, cnt] : count)
+		EXPECT_NEAR(cnt, 300, 5 * std::sqrt(300));
+}
+
+TEST(partition_test, constructor) {
+	auto argv = get_argv({"./executable"});
+	tgen::register_gen(argv.size() - 1, argv.data());
+
+	EXPECT_THROW_TGEN_PREFIX(tgen::partition(0), "size must be positive");
+	EXPECT_THROW_TGEN_PREFIX(tgen::partition(5).parts(6),
+							 "number of parts must be from 1 to size");
+	EXPECT_THROW_TGEN_PREFIX(tgen::partition(5).max_part(0),
+							 "maximum part must be positive");
+	EXPECT_THROW_TGEN_PREFIX(
+		tgen::partition(10).parts(3).max_part(3).gen(),
+		"invalid partition (contradicting constraints): tried to generate 3 "
+		"parts of at most 3, but the sum is 10");
+}
+
+TEST(partition_test, gen) {
+	auto argv = get_argv({"./executable"});
+	tgen::register_gen(argv.size() - 1, argv.data());
+
+	expect_uniform(tgen::partition(10), 10, 42);
+	expect_uniform(tgen::partition(10).max_part(3), 10, 14);
+	expect_uniform(tgen::partition(10).parts(3), 10, 8);
+	expect_uniform(tgen::partition(10).parts(4).max_part(4), 10, 5);
+	// 7 partitions of the complement 5 in the box.
+	expect_uniform(tgen::partition(95).parts(10).max_part(10), 95, 7);
+	// Tight bounds, where parts are penalized.
+	expect_uniform(tgen::partition(20).parts(5).max_part(6), 20, 18);
+	expect_uniform(tgen::partition(24).parts(8).max_part(5), 24, 33);
+
+	EXPECT_EQ(tgen::partition(1).gen().to_std(), std::vector<int>({1}));
+	EXPECT_EQ(tgen::partition(100).parts(10).max_part(10).gen().to_std(),
+			  std::vector<int>(10, 10));
+	EXPECT_EQ(tgen::partition(7).parts(1).gen().to_std(),
+			  std::vector<int>({7}));
+
+	// Large partitions.
+	auto parts = tgen::partition(1000000).gen().to_std();
+	EXPECT_EQ(std::accumulate(parts.begin(), parts.end(), 0LL), 1000000);
+	parts = tgen::partition(1000000).parts(1000).gen().to_std();
+	EXPECT_EQ(parts.size(), 1000);
+	EXPECT_EQ(std::accumulate(parts.begin(), parts.end(), 0LL), 1000000);
+	parts = tgen::partition(100000).parts(100).max_part(5000).gen().to_std();
+	EXPECT_EQ(parts.size(), 100);
+	EXPECT_LE(parts[0], 5000);
+	EXPECT_EQ(std::accumulate(parts.begin(), parts.end(), 0LL), 100000);
+
+	// Tight bounds on both the number of parts and the parts.
+	for (auto [size, count, value] : std::vector<std::tuple<int, int, int>>{
+			 {100000, 1000, 200},
+			 {100000, 300, 500},
+			 {1000000, 1000, 2000}}) {
+		auto gen = tgen::partition(size).parts(count).max_part(value);
+		parts = gen.gen().to_std();
+		EXPECT_EQ(parts.size(), count);
+		EXPECT_LE(parts[0], value);
+		EXPECT_EQ(std::accumulate(parts.begin(), parts.end(), 0LL), size);
+	}
+}
+
+TEST(partition_test, instance) {
+	EXPECT_THROW_TGEN_PREFIX(tgen::partition::instance({2, 0}),
+							 "parts must be positive");
+
+	tgen::partition::instance inst = {1, 3, 1, 2};
+	EXPECT_EQ(inst.size(), 4);
+	EXPECT_EQ(inst[0], 3);
+	std::stringstream out;
+	out << inst;
+	EXPECT_EQ(out.str(), "3 2 1 1");
+	EXPECT_EQ(inst.conjugate().to_std(), std::vector<int>({4, 2, 1}));
+	EXPECT_EQ(inst.conjugate().to_std(), std::vector<int>({3, 2, 1, 1}));
+}
+
+TEST(partition_test, permutation_cycles) {
+	auto argv = get_argv({"./executable"});
+	tgen::register_gen(argv.size() - 1, argv.data());
+
+	// A partition is given directly as the cycle sizes of a permutation.
+	for (int i = 0; i < 20; ++i) {
+		auto cycle_sizes = tgen::partition(30).gen();
+		auto perm = tgen::permutation(30).gen(cycle_sizes);
+		std::vector<int> cycles;
+		std::vector<bool> vis(30);
+		for (int v = 0; v < 30; ++v)
+			if (!vis[v]) {
+				int size = 0;
+				for (int u = v; !vis[u]; u = perm[u])
+					vis[u] = true, ++size;
+				cycles.push_back(size);
+			}
+		std::sort(cycles.rbegin(), cycles.rend());
+		EXPECT_EQ(cycles, cycle_sizes.to_std());
+	}
+}
@@ -2,7 +2,11 @@
 
 #include "tgen.h"
 
+#include <filesystem>
+#include <fstream>
+#include <memory_resource>
 #include <set>
+#include <string>
 #include <utility>
 #include <vector>
 
@@ -126,6 +130,22 @@ TEST(permutation_test, gen) {
 	}
 }
 
+TEST(permutation_test, gen_with_memory_resource) {
+	auto argv = get_argv({"./executable"});
+	tgen::register_gen(argv.size() - 1, argv.data());
+
+	auto perm = tgen::permutation(100).set(0, 5);
+	tgen::register_gen(argv.size() - 1, argv.data());
+	auto expected = perm.gen().to_std();
+	auto expected_cycles = perm.gen({50, 50}).to_std();
+
+	std::pmr::monotonic_buffer_resource arena;
+	perm.memory_resource(&arena);
+	tgen::register_gen(argv.size() - 1, argv.data());
+	EXPECT_EQ(perm.gen().to_std(), expected);
+	EXPECT_EQ(perm.gen({50, 50}).to_std(), expected_cycles);
+}
+
 TEST(permutation_test, gen_cycles_invalid) {
 	auto argv = get_argv({"./executable"});
 	tgen::register_gen(argv.size() - 1, argv.data());
@@ -166,3 +186,85 @@ TEST(permutation_test, gen_cycles) {
 		EXPECT_EQ(cycles, gen_cycles);
 	}
 }
+
+TEST(permutation_test, lazy_permutation_gen) {
+	auto argv = get_argv({"./executable"});
+	tgen::register_gen(argv.size() - 1, argv.data());
+
+	EXPECT_THROW_TGEN_PREFIX(tgen::lazy_permutation(0),
+							 "size must be positive");
+
+	// Small sizes are permutations, and inverse is the inverse.
+	for (int n : {1, 2, 3, 5, 16, 17, 1000}) {
+		auto inst = tgen::lazy_permutation(n).gen();
+		std::vector<long long> vec = inst.to_std();
+		std::vector<long long> sorted = vec;
+		std::sort(sorted.begin(), sorted.end());
+		for (int i = 0; i < n; ++i)
+			EXPECT_EQ(sorted[i], i);
+		inst.inverse();
+		for (int i = 0; i < n; ++i)
+			EXPECT_EQ(inst[vec[i]], i);
+	}
+
+	// Huge permutation, accessed out of order.
+	long long n = 1e12;
+	auto inst = tgen::lazy_permutation(n).gen();
+	auto inv = inst;
+	inv.inverse();
+	std::set<long long> seen;
+	for (long long i : {n - 1, 0LL, 123456789012LL, 1LL, n / 2}) {
+		long long value = inst[i];
+		EXPECT_TRUE(0 <= value and value < n);
+		EXPECT_EQ(inst[i], value);
+		EXPECT_EQ(inv[value], i);
+		seen.insert(value);
+	}
+	EXPECT_EQ(seen.size(), 5);
+
+	// Each position takes each value with about the same frequency.
+	std::vector<std::vector<int>> count(4, std::vector<int>(4));
+	for (int i = 0; i < 16000; ++i) {
+		auto small = tgen::lazy_permutation(4).gen();
+		for (int j = 0; j < 4; ++j)
+			++count[j][small[j]];
+	}
+	for (int j = 0; j < 4; ++j)
+		for (int v = 0; v < 4; ++v)
+			EXPECT_NEAR(count[j][v], 4000, 300);
+
+	auto printed = tgen::lazy_permutation(3).gen().add_1();
+	testing::internal::CaptureStdout();
+	std::cout << printed;
+	std::string out = testing::internal::GetCapturedStdout();
+	EXPECT_EQ(out.size(), 5);
+}
+
+TEST(permutation_test, read) {
+	auto argv = get_argv({"./executable"});
+	tgen::register_gen(argv.size() - 1, argv.data());
+	std::string path =
+		(std::filesystem::temp_directory_path() / "tgen_read_test.txt")
+			.string();
+
+	// 0-based and 1-based permutations.
+	auto inst = tgen::permutation(100).gen();
+	std::ofstream(path) << inst << '\n' << inst.add_1() << '\n';
+	tgen::reader in(path);
+	auto zero = tgen::permutation(100).read(in);
+	auto one = tgen::permutation(100).read(in);
+	EXPECT_EQ(zero.to_std(), inst.to_std());
+	EXPECT_EQ(one.to_std(), inst.to_std());
+	EXPECT_FALSE(zero.add_1_);
+	EXPECT_TRUE(one.add_1_);
+
+	std::ofstream(path) << "0 2 2";
+	tgen::reader repeated(path);
+	EXPECT_THROW_TGEN_PREFIX(tgen::permutation(3).read(repeated),
+							 "cannot have repeated values in permutation");
+	std::ofstream(path) << "2 0 1";
+	tgen::reader set(path);
+	EXPECT_THROW_TGEN_PREFIX(tgen::permutation(3).set(0, 1).read(set),
+							 "read values must satisfy `set`");
+	std::filesystem::remove(path);
+}
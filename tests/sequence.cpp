@@ -2,8 +2,20 @@
 
 #include "tgen.h"
 
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <functional>
+#include <fstream>
 #include <iostream>
+#include <limits>
+#include <map>
+#include <memory_resource>
+#include <numeric>
 #include <set>
+#include <string>
+#include <thread>
+#include <tuple>
 #include <utility>
 #include <vector>
 
@@ -217,6 +229,61 @@ TEST(sequence_test, instance_ops) {
 			  std::string("1 2 3 4 5 6"));
 }
 
+TEST(sequence_test, instance_sort) {
+	auto argv = get_argv({"./executable"});
+	tgen::register_gen(argv.size() - 1, argv.data());
+
+	// Radix sort of signed, unsigned and small integral values, and comparison
+	// sort of other values.
+	auto check = [](auto inst) {
+		auto vec = inst.to_std();
+		std::sort(vec.begin(), vec.end());
+		EXPECT_EQ(inst.sort().to_std(), vec);
+	};
+	check(tgen::sequence<int>(100000, -1e9, 1e9).gen());
+	check(tgen::sequence<int>(100000, 5, 10).gen());
+	check(tgen::sequence<long long>(100000, -4e18, 4e18).gen());
+	check(tgen::sequence<unsigned>(100000, 0, 4e9).gen());
+	check(tgen::sequence<char>(100000, -100, 100).gen());
+	check(tgen::sequence<double>(100000, -1, 1).gen());
+	check(tgen::sequence<std::string>::instance({"b", "ab", "a", "ab"}));
+}
+
+TEST(sequence_test, gen_threads) {
+	// Large fills and sorts give the same result for any number of threads,
+	// and `gen_each` gives the values of `gen`.
+	std::vector<std::vector<int>> fills, each, sorts;
+	for (const char *threads : {"--tgen-threads=1", "--tgen-threads=3"}) {
+		auto argv = get_argv({"./executable", threads});
+		auto seq = tgen::sequence<int>(300000, -1e9, 1e9).set(5, 7);
+		tgen::register_gen(argv.size() - 1, argv.data());
+		auto inst = seq.gen();
+		fills.push_back(inst.to_std());
+		sorts.push_back(inst.sort().to_std());
+		tgen::register_gen(argv.size() - 1, argv.data());
+		each.emplace_back();
+		seq.gen_each([&](int val) { each.back().push_back(val); });
+	}
+	EXPECT_EQ(fills[0], fills[1]);
+	EXPECT_EQ(fills[0], each[0]);
+	EXPECT_EQ(each[0], each[1]);
+	EXPECT_EQ(sorts[0], sorts[1]);
+	EXPECT_EQ(fills[0][5], 7);
+	EXPECT_TRUE(std::is_sorted(sorts[0].begin(), sorts[0].end()));
+
+	// The values are uniform.
+	std::vector<int> count(10);
+	for (int val : tgen::sequence<int>(1000000, 0, 9).gen().to_std())
+		++count[val];
+	for (int cnt : count)
+		EXPECT_NEAR(cnt, 100000, 2000);
+
+	auto argv = get_argv({"./executable", "--tgen-threads=0"});
+	EXPECT_THROW_TGEN_PREFIX(
+		tgen::register_gen(argv.size() - 1, argv.data()),
+		"expected positive number of threads in opt (--tgen-threads=0)");
+}
+
 TEST(sequence_test, gen_with_set) {
 	auto argv = get_argv({"./executable"});
 	tgen::register_gen(argv.size() - 1, argv.data());
@@ -303,6 +370,389 @@ TEST(sequence_test, gen_with_distinct) {
 	}
 }
 
+TEST(sequence_test, gen_with_single_distinct) {
+	auto argv = get_argv({"./executable"});
+	tgen::register_gen(argv.size() - 1, argv.data());
+
+	// Sparse range.
+	auto vec = tgen::sequence<int>(1000, 1, 1e9).distinct().gen().to_std();
+	EXPECT_EQ(std::set<int>(vec.begin(), vec.end()).size(), 1000);
+
+	// Dense range, with indices out of the constraint.
+	for (int i = 0; i < 100; ++i) {
+		sequence_test test(10, 1, 6);
+		test.distinct({1, 3, 5, 7, 8, 9});
+		test.check();
+	}
+
+	EXPECT_THROW_TGEN_PREFIX(tgen::sequence<int>(5, 1, 4).distinct().gen(),
+							 "invalid sequence (contradicting constraints)");
+
+	// Full 64-bit ranges, where the number of values does not fit.
+	auto full = tgen::sequence<long long>(
+					100, std::numeric_limits<long long>::min(),
+					std::numeric_limits<long long>::max())
+					.distinct()
+					.gen();
+	EXPECT_EQ(std::set<long long>(full.vec_.begin(), full.vec_.end()).size(),
+			  100);
+	auto full_u = tgen::sequence<unsigned long long>(
+					  100, 0, std::numeric_limits<unsigned long long>::max())
+					  .distinct()
+					  .gen();
+	EXPECT_EQ(std::set<unsigned long long>(full_u.vec_.begin(),
+										   full_u.vec_.end())
+				  .size(),
+			  100);
+
+	// Full ranges with distinct and set constraints.
+	auto full_set = tgen::sequence<long long>(
+						4, std::numeric_limits<long long>::min(),
+						std::numeric_limits<long long>::max())
+						.distinct({0, 1, 2})
+						.distinct({2, 3})
+						.set(0, 5)
+						.gen();
+	EXPECT_EQ(full_set[0], 5);
+	EXPECT_NE(full_set[1], full_set[2]);
+	auto full_u_set = tgen::sequence<unsigned long long>(
+						  4, 0, std::numeric_limits<unsigned long long>::max())
+						  .distinct({0, 1, 2})
+						  .distinct({2, 3})
+						  .set(0, 5)
+						  .gen();
+	EXPECT_EQ(full_u_set[0], 5u);
+	EXPECT_NE(full_u_set[1], full_u_set[2]);
+}
+
+TEST(sequence_test, gen_with_single_distinct_uniform) {
+	auto argv = get_argv({"./executable"});
+	tgen::register_gen(argv.size() - 1, argv.data());
+
+	auto seq = tgen::sequence<int>(3, 1, 3).distinct({0, 2});
+	std::map<std::vector<int>, int> count;
+	int total = 18000;
+	for (int i = 0; i < total; ++i)
+		++count[seq.gen().to_std()];
+	EXPECT_EQ(count.size(), 18);
+	for (auto [inst, cnt] : count)
+		EXPECT_NEAR(cnt, total / 18, total / 18 / 5);
+}
+
+TEST(sequence_test, gen_with_sum) {
+	auto argv = get_argv({"./executable"});
+	tgen::register_gen(argv.size() - 1, argv.data());
+
+	EXPECT_THROW_TGEN_PREFIX(tgen::sequence<int>(3, 1, 2).sum(7).gen(),
+							 "invalid sequence (contradicting constraints)");
+	EXPECT_THROW_TGEN_PREFIX(tgen::sequence<int>(3, 1, 2).sum(2).gen(),
+							 "invalid sequence (contradicting constraints)");
+	EXPECT_THROW_TGEN_PREFIX(
+		tgen::sequence<int>(3, 1, 2).sum(4).set(0, 2).set(1, 2).gen(),
+		"invalid sequence (contradicting constraints)");
+	EXPECT_THROW_TGEN_PREFIX(
+		tgen::sequence<int>(3, 1, 2).sum(4).equal(0, 1).gen(),
+		"sum can not be combined with equality or distinct constraints");
+	EXPECT_THROW_TGEN_PREFIX(tgen::sequence<int>(3, {1, 2}).sum(4),
+							 "sum requires a range of values");
+
+	for (auto [n, l, r, sum] : {std::tuple(1000, 1, 10000, 1000000LL),
+								std::tuple(1000, 1, 10, 9000LL),
+								std::tuple(1000, -5, 5, 0LL),
+								std::tuple(100, 0, 1000000000, 5LL)}) {
+		auto vec =
+			tgen::sequence<int>(n, l, r).set(0, l).sum(sum).gen().to_std();
+		EXPECT_EQ(vec[0], l);
+		for (int val : vec)
+			EXPECT_TRUE(l <= val and val <= r);
+		EXPECT_EQ(std::accumulate(vec.begin(), vec.end(), 0LL), sum);
+	}
+
+	// Huge ranges, with an active bound: the cost must not depend on it.
+	for (auto [r, sum] : {std::pair(100000000LL, 500000000LL),
+						  std::pair(1000000000LL, 5000000000LL),
+						  std::pair(1000000000000LL, 9000000000000LL)}) {
+		auto vec = tgen::sequence<long long>(10, 0, r).sum(sum).gen().to_std();
+		for (long long val : vec)
+			EXPECT_TRUE(0 <= val and val <= r);
+		EXPECT_EQ(std::accumulate(vec.begin(), vec.end(), 0LL), sum);
+	}
+}
+
+TEST(sequence_test, gen_with_sum_uniform) {
+	auto argv = get_argv({"./executable"});
+	tgen::register_gen(argv.size() - 1, argv.data());
+
+	// Stars and bars: 10 sequences of 3 values in [0, 5] with sum 3. Bounded:
+	// 7 sequences of 3 values in [0, 2] with sum 3, and 12 of 3 values in
+	// [0, 3] with sum 5 (without a table).
+	for (auto [r, sum, ways] : {std::tuple(5, 3, 10), std::tuple(2, 3, 7),
+								std::tuple(3, 5, 12)}) {
+		auto seq = tgen::sequence<int>(3, 0, r).sum(sum);
+		std::map<std::vector<int>, int> count;
+		int total = 1000 * ways;
+		for (int i = 0; i < total; ++i)
+			++count[seq.gen().to_std()];
+		EXPECT_EQ(count.size(), ways);
+		for (auto [inst, cnt] : count)
+			EXPECT_NEAR(cnt, 1000, 200);
+	}
+}
+
+TEST(sequence_test, gen_with_count) {
+	auto argv = get_argv({"./executable"});
+	tgen::register_gen(argv.size() - 1, argv.data());
+
+	EXPECT_THROW_TGEN_PREFIX(tgen::sequence<int>(3, 1, 2).count(1, -1),
+							 "count must be non-negative");
+	EXPECT_THROW_TGEN_PREFIX(tgen::sequence<int>(3, 1, 2).count(3, 1),
+							 "value must be in the defined range");
+	EXPECT_THROW_TGEN_PREFIX(tgen::sequence<int>(3, {1, 5}).count(2, 1),
+							 "value must be in the set of values");
+	EXPECT_THROW_TGEN_PREFIX(
+		tgen::sequence<int>(3, 1, 2).count(1, 1).count(1, 2),
+		"must not count a value with two different counts");
+	EXPECT_THROW_TGEN_PREFIX(tgen::sequence<int>(3, 1, 2).count(1, 4).gen(),
+							 "invalid sequence (contradicting constraints)");
+	EXPECT_THROW_TGEN_PREFIX(
+		tgen::sequence<int>(3, 1, 2).count(1, 1).count(2, 1).gen(),
+		"invalid sequence (contradicting constraints)");
+	EXPECT_THROW_TGEN_PREFIX(
+		tgen::sequence<int>(3, 1, 2).count(1, 1).set(0, 1).set(1, 1).gen(),
+		"invalid sequence (contradicting constraints)");
+	EXPECT_THROW_TGEN_PREFIX(
+		tgen::sequence<int>(3, 1, 2).count(1, 1).distinct().gen(),
+		"count can not be combined with order, sum, equality or distinct "
+		"constraints");
+
+	for (auto [n, l, r] : {std::tuple(1000, 1, 10), std::tuple(1000, -15, -5),
+						   std::tuple(100, 0, 1000000000)}) {
+		std::map<int, int> frequencies = {{l, 10}, {l + 1, 0}, {r, 50}};
+		auto vec = tgen::sequence<int>(n, l, r)
+					   .frequencies(frequencies)
+					   .set(0, r)
+					   .set(1, l + 2)
+					   .gen()
+					   .to_std();
+		EXPECT_EQ(vec[0], r);
+		EXPECT_EQ(vec[1], l + 2);
+		for (int val : vec)
+			EXPECT_TRUE(l <= val and val <= r);
+		for (auto [value, cnt] : frequencies)
+			EXPECT_EQ(std::count(vec.begin(), vec.end(), value), cnt);
+	}
+
+	// Every value of the set counted.
+	auto vec = tgen::sequence<int>(6, {10, 20, 30})
+				   .count(10, 1)
+				   .count(20, 2)
+				   .count(30, 3)
+				   .gen()
+				   .to_std();
+	std::map<int, int> count;
+	for (int val : vec)
+		++count[val];
+	std::map<int, int> expected = {{10, 1}, {20, 2}, {30, 3}};
+	EXPECT_EQ(count, expected);
+}
+
+TEST(sequence_test, gen_with_count_uniform) {
+	auto argv = get_argv({"./executable"});
+	tgen::register_gen(argv.size() - 1, argv.data());
+
+	// 1 exactly once, 2 never, and sequence[0] = 3: 2 positions for the 1, and
+	// 2 values for the other one.
+	auto set_seq =
+		tgen::sequence<int>(3, 1, 3).count(1, 1).count(2, 0).set(0, 3);
+	std::map<std::vector<int>, int> set_count;
+	for (int i = 0; i < 2000; ++i)
+		++set_count[set_seq.gen().to_std()];
+	EXPECT_EQ(set_count.size(), 2);
+	for (auto [inst, cnt] : set_count)
+		EXPECT_NEAR(cnt, 1000, 200);
+
+	// 9 sequences of 3 values in [1, 4] with 1 exactly twice, and 6 sequences
+	// of 2 values in [1, 4] with 2 exactly once.
+	for (auto [n, value, ways] : {std::tuple(3, 1, 9), std::tuple(2, 2, 6)}) {
+		auto seq = tgen::sequence<int>(n, 1, 4).count(value, n - 1);
+		std::map<std::vector<int>, int> count;
+		int total = 1000 * ways;
+		for (int i = 0; i < total; ++i)
+			++count[seq.gen().to_std()];
+		EXPECT_EQ(count.size(), ways);
+		for (auto [inst, cnt] : count)
+			EXPECT_NEAR(cnt, 1000, 200);
+	}
+}
+
+TEST(sequence_test, gen_sorted) {
+	auto argv = get_argv({"./executable"});
+	tgen::register_gen(argv.size() - 1, argv.data());
+
+	EXPECT_THROW_TGEN_PREFIX(tgen::sequence<int>(4, 1, 3).increasing().gen(),
+							 "invalid sequence (contradicting constraints)");
+	EXPECT_THROW_TGEN_PREFIX(
+		tgen::sequence<int>(3, 1, 5).sorted().set(0, 1).gen(),
+		"sorted sequences can not be combined with other constraints");
+	EXPECT_THROW_TGEN_PREFIX(
+		tgen::sequence<int>(3, 1, 5).increasing().distinct().gen(),
+		"sorted sequences can not be combined with other constraints");
+
+	// Small and large sequences, with few and many values (the subset
+	// samplers draw the smaller side).
+	for (auto [n, l, r] : {std::tuple(10, 1, 5), std::tuple(10, 1, 100),
+						   std::tuple(100000, -5, 5),
+						   std::tuple(100000, 1, 150000),
+						   std::tuple(100000, 0, 1000000000)}) {
+		auto vec = tgen::sequence<int>(n, l, r).sorted().gen().to_std();
+		EXPECT_EQ(vec.size(), n);
+		EXPECT_TRUE(std::is_sorted(vec.begin(), vec.end()));
+		EXPECT_TRUE(l <= vec.front() and vec.back() <= r);
+		if (n > r - l)
+			continue;
+		vec = tgen::sequence<int>(n, l, r).increasing().gen().to_std();
+		EXPECT_EQ(vec.size(), n);
+		EXPECT_TRUE(std::adjacent_find(vec.begin(), vec.end(),
+									   std::greater_equal<int>()) == vec.end());
+		EXPECT_TRUE(l <= vec.front() and vec.back() <= r);
+	}
+
+	auto big = tgen::sequence<long long>(1000, -4e18, 4e18).increasing().gen();
+	EXPECT_TRUE(std::is_sorted(big.vec_.begin(), big.vec_.end()));
+	auto set = tgen::sequence<int>(5, {10, 20, 30}).sorted().gen().to_std();
+	EXPECT_TRUE(std::is_sorted(set.begin(), set.end()));
+	for (int val : set)
+		EXPECT_TRUE(val == 10 or val == 20 or val == 30);
+	auto real = tgen::sequence<double>(1000, -1, 1).increasing().gen();
+	EXPECT_TRUE(std::is_sorted(real.vec_.begin(), real.vec_.end()));
+	EXPECT_TRUE(-1 <= real[0] and real[999] <= 1);
+}
+
+TEST(sequence_test, gen_sorted_uniform) {
+	auto argv = get_argv({"./executable"});
+	tgen::register_gen(argv.size() - 1, argv.data());
+
+	// Sorted: 10 multisets of 3 values in [1, 3], and 5 of 4 values in [1, 2].
+	// Increasing: 6 subsets of 2 values in [1, 4], and 4 of 3 values in
+	// [1, 4].
+	for (auto [n, r, increasing, ways] :
+		 {std::tuple(3, 3, false, 10), std::tuple(4, 2, false, 5),
+		  std::tuple(2, 4, true, 6), std::tuple(3, 4, true, 4)}) {
+		auto seq = tgen::sequence<int>(n, 1, r);
+		increasing ? seq.increasing() : seq.sorted();
+		std::map<std::vector<int>, int> count;
+		int total = 1000 * ways;
+		for (int i = 0; i < total; ++i)
+			++count[seq.gen().to_std()];
+		EXPECT_EQ(count.size(), ways);
+		for (auto [inst, cnt] : count)
+			EXPECT_NEAR(cnt, 1000, 200);
+	}
+}
+
+TEST(sequence_test, gen_each) {
+	auto argv = get_argv({"./executable"});
+	tgen::register_gen(argv.size() - 1, argv.data());
+
+	std::vector<int> vec;
+	tgen::sequence<int>(1000, 1, 10).sorted().gen_each(
+		[&](int val) { vec.push_back(val); });
+	EXPECT_EQ(vec.size(), 1000);
+	EXPECT_TRUE(std::is_sorted(vec.begin(), vec.end()));
+
+	vec.clear();
+	tgen::sequence<int>(100, {5, 7}).set(3, 7).gen_each(
+		[&](int val) { vec.push_back(val); });
+	EXPECT_EQ(vec.size(), 100);
+	EXPECT_EQ(vec[3], 7);
+	for (int val : vec)
+		EXPECT_TRUE(val == 5 or val == 7);
+
+	vec.clear();
+	tgen::sequence<int>(10, 1, 10).distinct().gen_each(
+		[&](int val) { vec.push_back(val); });
+	EXPECT_EQ(std::set<int>(vec.begin(), vec.end()).size(), 10);
+}
+
+TEST(sequence_test, gen_with_different_paths) {
+	auto argv = get_argv({"./executable"});
+	tgen::register_gen(argv.size() - 1, argv.data());
+
+	for (int i = 0; i < 100; ++i) {
+		int n = 20;
+		auto seq = tgen::sequence<int>(n, 1, 3).set(5, 2).set(7, 2).equal(
+			10, 12);
+		// Path 0, ..., 9, {10, 12}, 13, ..., 19.
+		for (int j = 1; j < n; ++j)
+			if (j < 11 or j > 13)
+				seq.different(j - 1, j);
+		seq.different(12, 13);
+		auto inst = seq.gen();
+		EXPECT_EQ(inst[5], 2);
+		EXPECT_EQ(inst[7], 2);
+		EXPECT_EQ(inst[10], inst[12]);
+		for (int j = 1; j < n; ++j)
+			if (j < 11 or j > 13)
+				EXPECT_NE(inst[j - 1], inst[j]);
+		EXPECT_NE(inst[12], inst[13]);
+	}
+
+	// Two values: a path alternates, so set values must agree with parity.
+	EXPECT_EQ(tgen::sequence<int>(4, 0, 1)
+				  .set(1, 0)
+				  .different(0, 1)
+				  .different(1, 2)
+				  .different(2, 3)
+				  .gen()
+				  .to_std(),
+			  std::vector<int>({1, 0, 1, 0}));
+	EXPECT_THROW_TGEN_PREFIX(tgen::sequence<int>(3, 0, 1)
+								 .set(0, 0)
+								 .set(2, 1)
+								 .different(0, 1)
+								 .different(1, 2)
+								 .gen(),
+							 "invalid sequence (contradicting constraints)");
+	EXPECT_THROW_TGEN_PREFIX(tgen::sequence<int>(3, 1, 5)
+								 .set(0, 2)
+								 .set(1, 2)
+								 .different(0, 1)
+								 .gen(),
+							 "invalid sequence (contradicting constraints)");
+
+	// With other distinct constraints, the differences join them, without
+	// changing the generator.
+	auto mixed = tgen::sequence<int>(6, 1, 4).distinct({0, 1, 2});
+	for (int j = 3; j < 6; ++j)
+		mixed.different(j - 1, j);
+	for (int i = 0; i < 10; ++i) {
+		auto inst = mixed.gen();
+		EXPECT_EQ(std::set<int>({inst[0], inst[1], inst[2]}).size(), 3);
+		for (int j = 3; j < 6; ++j)
+			EXPECT_NE(inst[j - 1], inst[j]);
+	}
+	EXPECT_EQ(mixed.distinct_constraints_.size(), 1);
+	EXPECT_EQ(mixed.different_.size(), 3);
+}
+
+TEST(sequence_test, gen_with_different_paths_uniform) {
+	auto argv = get_argv({"./executable"});
+	tgen::register_gen(argv.size() - 1, argv.data());
+
+	// Path 0-1-2-3 over 3 values, with index 3 set to 0: 8 valid sequences,
+	// that must be equally likely.
+	auto seq = tgen::sequence<int>(4, 0, 2).set(3, 0);
+	for (int i = 1; i < 4; ++i)
+		seq.different(i - 1, i);
+	std::map<std::vector<int>, int> count;
+	int total = 16000;
+	for (int i = 0; i < total; ++i)
+		++count[seq.gen().to_std()];
+	EXPECT_EQ(count.size(), 8);
+	for (auto [inst, cnt] : count)
+		EXPECT_NEAR(cnt, total / 8, total / 8 / 5);
+}
+
 TEST(sequence_test, gen_with_all_invalid) {
 	auto argv = get_argv({"./executable"});
 	tgen::register_gen(argv.size() - 1, argv.data());
@@ -342,39 +792,88 @@ TEST(sequence_test, gen_with_all_complex) {
 	auto argv = get_argv({"./executable"});
 	tgen::register_gen(argv.size() - 1, argv.data());
 
-	EXPECT_THROW_TGEN_PREFIX(
-		tgen::sequence<int>(10, 1, 10)
-			.distinct({0, 1, 2})
-			.distinct({2, 3, 4})
-			.distinct({4, 5, 0})
-			.gen(),
-		"failed to generate sequence: complex constraints");
+	for (int i = 0; i < 100; ++i) {
+		{
+			sequence_test test(10, 1, 10);
+			test.distinct({0, 1, 2});
+			test.distinct({2, 3, 4});
+			test.distinct({4, 5, 0});
 
-	EXPECT_THROW_TGEN_PREFIX(
-		tgen::sequence<int>(10, 1, 10)
-			.distinct({0, 1})
-			.distinct({1, 2})
-			.set(0, 5)
-			.set(2, 6)
-			.gen(),
-		"failed to generate sequence: complex constraints");
+			test.check();
+		}
+		{
+			sequence_test test(10, 1, 10);
+			test.distinct({0, 1});
+			test.distinct({1, 2});
+			test.set(0, 5);
+			test.set(2, 6);
+
+			test.check();
+		}
+		{
+			sequence_test test(10, 1, 10);
+			test.distinct({0, 1});
+			test.distinct({0, 1});
+			test.distinct({0, 1});
 
-	EXPECT_THROW_TGEN_PREFIX(
-		tgen::sequence<int>(10, 1, 10)
-			.distinct({0, 1})
-			.distinct({0, 1})
-			.distinct({0, 1})
-			.gen(),
-		"failed to generate sequence: complex constraints");
+			test.check();
+		}
+		{
+			sequence_test test(10, 1, 10);
+			test.distinct({0, 1});
+			test.distinct({1, 2, 3});
+			test.distinct({3, 4});
+			test.equal(0, 4);
+
+			test.check();
+		}
+	}
 
-	EXPECT_THROW_TGEN_PREFIX(
-		tgen::sequence<int>(10, 1, 10)
-			.distinct({0, 1})
-			.distinct({1, 2, 3})
-			.distinct({3, 4})
-			.equal(0, 4)
-			.gen(),
-		"failed to generate sequence: complex constraints");
+	// Every pair of 4 indices different, with 3 values: no coloring is found.
+	auto seq = tgen::sequence<int>(4, 1, 3);
+	for (int i = 0; i < 4; ++i)
+		for (int j = i + 1; j < 4; ++j)
+			seq.different(i, j);
+	EXPECT_THROW_TGEN_PREFIX(seq.gen(),
+							 "failed to generate sequence: complex constraints");
+}
+
+TEST(sequence_test, gen_with_all_complex_uniform) {
+	auto argv = get_argv({"./executable"});
+	tgen::register_gen(argv.size() - 1, argv.data());
+
+	// Cycle of 4 different values, over 3 values: the 18 valid sequences must
+	// be equally likely.
+	auto seq = tgen::sequence<int>(4, 0, 2);
+	for (int i = 0; i < 4; ++i)
+		seq.different(i, (i + 1) % 4);
+	std::map<std::vector<int>, int> count;
+	int total = 18000;
+	for (int i = 0; i < total; ++i)
+		++count[seq.gen().to_std()];
+	EXPECT_EQ(count.size(), 18);
+	for (auto [inst, cnt] : count)
+		EXPECT_NEAR(cnt, total / 18, total / 18 / 5);
+}
+
+TEST(sequence_test, gen_with_all_complex_glauber) {
+	auto argv = get_argv({"./executable"});
+	tgen::register_gen(argv.size() - 1, argv.data());
+
+	EXPECT_THROW_TGEN_PREFIX(tgen::sequence<int>(5, 1, 5).mixing_sweeps(0),
+							 "number of sweeps must be positive");
+
+	// Sliding windows of 3 distinct values: each index is in 3 constraints.
+	int n = 2000;
+	sequence_test test(n, 1, 5);
+	for (int i = 0; i + 2 < n; ++i)
+		test.distinct({i, i + 1, i + 2});
+	test.set(0, 1);
+	test.set(n / 2, 5);
+	test.check();
+
+	test.s.mixing_sweeps(3);
+	test.check();
 }
 
 TEST(sequence_test, gen_two_distincts_one_set) {
@@ -436,6 +935,104 @@ TEST(sequence_test, gen_with_all) {
 	}
 }
 
+TEST(sequence_test, gen_with_memory_resource) {
+	auto argv = get_argv({"./executable"});
+	tgen::register_gen(argv.size() - 1, argv.data());
+
+	auto seq = tgen::sequence<int>(100, 1, 100).distinct({0, 1, 2}).equal(3, 4);
+	tgen::register_gen(argv.size() - 1, argv.data());
+	auto expected = seq.gen().to_std();
+
+	for (int i = 0; i < 2; ++i) {
+		std::pmr::monotonic_buffer_resource arena;
+		tgen::register_gen(argv.size() - 1, argv.data());
+		EXPECT_EQ(seq.memory_resource(&arena).gen().to_std(), expected);
+	}
+}
+
+TEST(sequence_test, read) {
+	auto argv = get_argv({"./executable"});
+	tgen::register_gen(argv.size() - 1, argv.data());
+	std::string path =
+		(std::filesystem::temp_directory_path() / "tgen_read_test.txt")
+			.string();
+	auto write = [&](const std::string &text) { std::ofstream(path) << text; };
+
+	// Reads back printed instances, and what comes after them.
+	auto seq = tgen::sequence<long long>(1000, -1e18, 1e18).set(3, 5);
+	auto inst = seq.gen();
+	{
+		std::ofstream out(path);
+		out << inst.size() << '\n' << inst << "\n  0.5\nabc";
+	}
+	tgen::reader in(path);
+	EXPECT_EQ(in.read<int>(), 1000);
+	EXPECT_EQ(seq.read(in).to_std(), inst.to_std());
+	EXPECT_EQ(in.read<double>(), 0.5);
+	EXPECT_FALSE(in.eof());
+	EXPECT_EQ(in.read<std::string>(), "abc");
+	EXPECT_TRUE(in.eof());
+	EXPECT_THROW_TGEN_PREFIX(in.read<int>(), "could not read");
+
+	// Limits of integral types.
+	write("-2147483648 2147483647 -0 0012345678901 -9223372036854775808 "
+		  "9223372036854775807 18446744073709551615 2147483648 -");
+	tgen::reader limits(path);
+	EXPECT_EQ(limits.read<int>(2),
+			  std::vector<int>({-2147483647 - 1, 2147483647}));
+	EXPECT_EQ(limits.read<int>(), 0);
+	EXPECT_EQ(limits.read<long long>(), 12345678901);
+	EXPECT_EQ(limits.read<long long>(2),
+			  std::vector<long long>({std::numeric_limits<long long>::min(),
+									  std::numeric_limits<long long>::max()}));
+	EXPECT_EQ(limits.read<unsigned long long>(), ~0ULL);
+	EXPECT_THROW_TGEN_PREFIX(limits.read<int>(), "could not read");
+	limits.read<std::string>();
+	EXPECT_THROW_TGEN_PREFIX(limits.read<int>(), "could not read");
+
+	write("1 2x 3");
+	tgen::reader bad(path);
+	EXPECT_EQ(bad.read<int>(), 1);
+	EXPECT_THROW_TGEN_PREFIX(bad.read<int>(), "could not read");
+
+	write("G A T\n");
+	tgen::reader dna(path);
+	EXPECT_EQ(tgen::sequence<char>(3, {'A', 'C', 'G', 'T'}).read(dna).to_std(),
+			  std::vector<char>({'G', 'A', 'T'}));
+
+	// Checks the constraints.
+	auto check = [&](const std::string &text, auto gen, const char *error) {
+		write(text);
+		tgen::reader text_in(path);
+		EXPECT_THROW_TGEN_PREFIX(gen.read(text_in), error);
+	};
+	check("1 2 6", tgen::sequence<int>(3, 1, 5),
+		  "read values must be in the defined range");
+	check("1 2 3", tgen::sequence<int>(3, 1, 5).set(0, 2),
+		  "read values must be in the defined range");
+	check("A B", tgen::sequence<char>(2, {'A', 'C'}),
+		  "read values must be in the set of values");
+	check("A A", tgen::sequence<char>(2, {'A', 'C'}).set(1, 'C'),
+		  "read values must satisfy `set`");
+	check("1 2 3", tgen::sequence<int>(3, 1, 5).equal(0, 2),
+		  "read values must satisfy `equal`");
+	check("1 2 1", tgen::sequence<int>(3, 1, 5).different(0, 2),
+		  "read values must satisfy `different`");
+	check("1 2 1", tgen::sequence<int>(3, 1, 5).distinct(),
+		  "read values must satisfy `distinct`");
+	check("1 2 1", tgen::sequence<int>(3, 1, 5).sum(5),
+		  "read values must satisfy `sum`");
+	check("1 2 1", tgen::sequence<int>(3, 1, 5).count(1, 1),
+		  "read values must satisfy `count`");
+	check("1 2 1", tgen::sequence<int>(3, 1, 5).count(3, 1),
+		  "read values must satisfy `count`");
+	check("1 2 1", tgen::sequence<int>(3, 1, 5).sorted(),
+		  "read values must satisfy `sorted`");
+	check("1 2 2", tgen::sequence<int>(3, 1, 5).increasing(),
+		  "read values must satisfy `increasing`");
+	std::filesystem::remove(path);
+}
+
 TEST(sequence_test, gen_until_not_found) {
 	auto argv = get_argv({"./executable"});
 	tgen::register_gen(argv.size() - 1, argv.data());
@@ -468,10 +1065,315 @@ TEST(sequence_test, gen_until) {
 	}
 }
 
+TEST(sequence_test, gen_until_threads) {
+	// The accepted candidate does not depend on the number of threads, nor on
+	// `gen_until_parallel`, and errors of the generator are propagated.
+	auto pred = [](const auto &inst) {
+		auto vec = inst.to_std();
+		return std::is_sorted(vec.begin(), vec.end() - 7);
+	};
+	std::vector<std::vector<int>> found;
+	std::vector<unsigned long long> attempts;
+	for (const char *threads : {"--tgen-threads=1", "--tgen-threads=4"})
+		for (bool parallel : {false, true}) {
+			auto argv = get_argv({"./executable", threads});
+			tgen::register_gen(argv.size() - 1, argv.data());
+			tgen::stats::reset();
+			for (int i = 0; i < 5; ++i) {
+				auto seq = tgen::sequence<int>(10, 0, 9);
+				auto inst = parallel ? seq.gen_until_parallel(pred, 1000)
+									 : seq.gen_until(pred, 1000);
+				found.push_back(inst.to_std());
+			}
+			found.push_back({tgen::next(0, 1000000)});
+			attempts.push_back(tgen::stats::gen_until_attempts);
+
+			EXPECT_THROW_TGEN_PREFIX(
+				tgen::sequence<int>(3, 0, 1).distinct().gen_until_parallel(
+					[](const auto &) { return true; }, 10),
+				"invalid sequence (contradicting constraints)");
+		}
+	for (std::size_t i = 6; i < found.size(); ++i)
+		EXPECT_EQ(found[i], found[i - 6]);
+	for (int i = 0; i < 5; ++i)
+		EXPECT_TRUE(std::is_sorted(found[i].begin(), found[i].end() - 7));
+	// Speculative candidates after the accepted one are not counted.
+	for (unsigned long long count : attempts)
+		EXPECT_EQ(count, attempts[0]);
+	tgen::stats::reset();
+}
+
+TEST(sequence_test, gen_until_calls_predicate_in_order) {
+	auto argv = get_argv({"./executable", "--tgen-threads=4"});
+	tgen::register_gen(argv.size() - 1, argv.data());
+
+	// Stateful predicate, that is only called on the calling thread.
+	std::vector<int> calls;
+	auto id = std::this_thread::get_id();
+	tgen::sequence<int>(5, 0, 9).gen_until(
+		[&](const auto &inst) {
+			EXPECT_EQ(std::this_thread::get_id(), id);
+			calls.push_back(inst[0]);
+			return calls.size() == 20;
+		},
+		100);
+	EXPECT_EQ(calls.size(), 20);
+}
+
+/*
+ * static_sequence.
+ */
+
+TEST(sequence_test, static_sequence_constexpr) {
+	constexpr auto seq =
+		tgen::static_sequence<int, 4>(1, 10).set(0, 3).equal(0, 1).distinct(
+			{1, 2, 3});
+	static_assert(seq.find_internal(0) == seq.find_internal(1));
+	static_assert(seq.defined_[0] and seq.value_[0] == 3);
+	static_assert(seq.different_[2] == 0b1010);
+}
+
+TEST(sequence_test, static_sequence_invalid) {
+	auto argv = get_argv({"./executable"});
+	tgen::register_gen(argv.size() - 1, argv.data());
+
+	EXPECT_THROW_TGEN_PREFIX((tgen::static_sequence<int, 3>(2, 1)),
+							 "value range must be valid");
+	EXPECT_THROW_TGEN_PREFIX((tgen::static_sequence<int, 3>(1, 5).set(3, 1)),
+							 "index must be valid");
+	EXPECT_THROW_TGEN_PREFIX((tgen::static_sequence<int, 3>(1, 5).set(0, 6)),
+							 "value must be in the domain of values");
+	EXPECT_THROW_TGEN_PREFIX(
+		(tgen::static_sequence<int, 3, tgen::set_domain<int>>({2, 4}).set(0,
+																		   3)),
+		"value must be in the domain of values");
+
+	EXPECT_THROW_TGEN_PREFIX(
+		(tgen::static_sequence<int, 3>(1, 5).set(0, 1).equal(0, 1).set(1, 2))
+			.gen(),
+		"invalid sequence (contradicting constraints)");
+	EXPECT_THROW_TGEN_PREFIX(
+		(tgen::static_sequence<int, 3>(1, 5).equal(0, 1).different(0, 1))
+			.gen(),
+		"invalid sequence (contradicting constraints)");
+	EXPECT_THROW_TGEN_PREFIX(
+		(tgen::static_sequence<int, 3>(1, 2).distinct()).gen(),
+		"invalid sequence (contradicting constraints)");
+	EXPECT_THROW_TGEN_PREFIX(
+		(tgen::static_sequence<int, 3>(1, 5).set(0, 1).set(2, 1).different(0,
+																		   2))
+			.gen(),
+		"invalid sequence (contradicting constraints)");
+}
+
+TEST(sequence_test, static_sequence_gen) {
+	auto argv = get_argv({"./executable"});
+	tgen::register_gen(argv.size() - 1, argv.data());
+
+	for (int i = 0; i < 100; ++i) {
+		auto inst = tgen::static_sequence<int, 6>(1, 6)
+						.set(0, 2)
+						.equal_range(0, 1)
+						.distinct({1, 2, 3})
+						.different(3, 4)
+						.different(4, 5)
+						.gen();
+		EXPECT_EQ(inst.size(), 6);
+		for (int j = 0; j < 6; ++j)
+			EXPECT_TRUE(1 <= inst[j] and inst[j] <= 6);
+		EXPECT_EQ(inst[0], 2);
+		EXPECT_EQ(inst[1], 2);
+		EXPECT_EQ(std::set<int>({inst[1], inst[2], inst[3]}).size(), 3);
+		EXPECT_NE(inst[3], inst[4]);
+		EXPECT_NE(inst[4], inst[5]);
+	}
+
+	auto dna = tgen::static_sequence<char, 8, tgen::set_domain<char>>(
+		{'A', 'C', 'G', 'T'});
+	for (int i = 1; i < 8; ++i)
+		dna.different(i - 1, i);
+	for (int i = 0; i < 100; ++i) {
+		auto inst = dna.gen();
+		for (int j = 0; j < 8; ++j)
+			EXPECT_TRUE(std::string("ACGT").find(inst[j]) != std::string::npos);
+		for (int j = 1; j < 8; ++j)
+			EXPECT_NE(inst[j - 1], inst[j]);
+	}
+
+	auto perm = tgen::static_sequence<int, 5>(1, 5).distinct().gen().sort();
+	EXPECT_EQ(perm.to_std(), (std::array<int, 5>{1, 2, 3, 4, 5}));
+
+	// Long paths of differences, with few values.
+	for (int k = 2; k <= 4; ++k) {
+		auto path = tgen::static_sequence<int, 64>(1, k).set(10, 1);
+		for (int i = 1; i < 64; ++i)
+			path.different(i - 1, i);
+		for (int i = 0; i < 20; ++i) {
+			auto inst = path.gen();
+			EXPECT_EQ(inst[10], 1);
+			for (int j = 1; j < 64; ++j)
+				EXPECT_NE(inst[j - 1], inst[j]);
+		}
+	}
+
+	// Cycle of differences, too unlikely for rejection.
+	auto cycle = tgen::static_sequence<int, 64>(1, 3);
+	for (int i = 0; i < 64; ++i)
+		cycle.different(i, (i + 1) % 64);
+	auto inst = cycle.gen();
+	for (int i = 0; i < 64; ++i)
+		EXPECT_NE(inst[i], inst[(i + 1) % 64]);
+}
+
+TEST(sequence_test, static_sequence_uniform) {
+	auto argv = get_argv({"./executable"});
+	tgen::register_gen(argv.size() - 1, argv.data());
+
+	// Triangle of differences plus a pendant edge, over 3 values: the 12 valid
+	// sequences must be equally likely.
+	auto seq = tgen::static_sequence<int, 4>(0, 2)
+				   .different(0, 1)
+				   .different(1, 2)
+				   .different(0, 2)
+				   .different(2, 3);
+	std::map<std::array<int, 4>, int> count;
+	int total = 18000;
+	for (int i = 0; i < total; ++i)
+		++count[seq.gen().to_std()];
+	EXPECT_EQ(count.size(), 12);
+	for (auto [inst, cnt] : count)
+		EXPECT_NEAR(cnt, total / 12, total / 12 / 5);
+}
+
+TEST(sequence_test, static_sequence_tree_uniform) {
+	auto argv = get_argv({"./executable"});
+	tgen::register_gen(argv.size() - 1, argv.data());
+
+	// Star of differences around index 1, and a path from it through a set
+	// index, over 3 values. Valid sequences are counted by brute force.
+	auto seq = tgen::static_sequence<int, 5>(0, 2)
+				   .different(1, 0)
+				   .different(1, 2)
+				   .different(1, 3)
+				   .different(3, 4)
+				   .set(3, 0);
+	int ways = 0;
+	for (int mask = 0; mask < 243; ++mask) {
+		std::array<int, 5> vec;
+		for (int i = 0, rest = mask; i < 5; ++i, rest /= 3)
+			vec[i] = rest % 3;
+		ways += vec[3] == 0 and vec[1] != vec[0] and vec[1] != vec[2] and
+				vec[1] != vec[3] and vec[3] != vec[4];
+	}
+	std::map<std::array<int, 5>, int> count;
+	int total = 1000 * ways;
+	for (int i = 0; i < total; ++i)
+		++count[seq.gen().to_std()];
+	EXPECT_EQ(count.size(), ways);
+	for (auto [inst, cnt] : count)
+		EXPECT_NEAR(cnt, 1000, 200);
+}
+
 /*
  * sequence_op.
  */
 
+TEST(sequence_test, lazy_sequence_gen) {
+	auto argv = get_argv({"./executable"});
+	tgen::register_gen(argv.size() - 1, argv.data());
+
+	EXPECT_THROW_TGEN_PREFIX(tgen::lazy_sequence<int>(0, 1, 5),
+							 "size must be positive");
+	EXPECT_THROW_TGEN_PREFIX(tgen::lazy_sequence<int>(10, 1, 5).set(10, 1),
+							 "index must be valid");
+	EXPECT_THROW_TGEN_PREFIX(tgen::lazy_sequence<int>(10, 1, 5).set(0, 6),
+							 "value must be in the domain of values");
+	EXPECT_THROW_TGEN_PREFIX(
+		tgen::lazy_sequence<int>(10, 1, 5).set(0, 1).set(0, 2),
+		"must not set to two different values");
+
+	// Values are the same on every access, in any order.
+	long long n = 1e10;
+	auto inst = tgen::lazy_sequence<long long>(n, 1, 1e18)
+					.set(0, 5)
+					.set(n - 1, 6)
+					.gen();
+	EXPECT_EQ(inst.size(), n);
+	EXPECT_EQ(inst[0], 5);
+	EXPECT_EQ(inst[n - 1], 6);
+	std::vector<long long> idx = {n - 2, 1, 12345678901, 2, n / 2};
+	std::vector<long long> vals;
+	for (long long i : idx)
+		vals.push_back(inst[i]);
+	for (int i = idx.size() - 1; i >= 0; --i) {
+		EXPECT_EQ(inst[idx[i]], vals[i]);
+		EXPECT_TRUE(1 <= vals[i] and vals[i] <= 1e18);
+	}
+	auto other = tgen::lazy_sequence<long long>(n, 1, 1e18).gen();
+	EXPECT_NE(other[1], inst[1]);
+
+	// Small instances, and uniformity.
+	auto small = tgen::lazy_sequence<int>(100000, 0, 9).gen();
+	auto vec = small.to_std();
+	std::vector<int> count(10);
+	for (int i = 0; i < 100000; ++i) {
+		EXPECT_EQ(vec[i], small[i]);
+		++count[vec[i]];
+	}
+	for (int cnt : count)
+		EXPECT_NEAR(cnt, 10000, 500);
+
+	auto dna = tgen::lazy_sequence<char, tgen::set_domain<char>>(
+				   4, {'A', 'C', 'G', 'T'})
+				   .set(2, 'G')
+				   .gen();
+	EXPECT_EQ(dna[2], 'G');
+	testing::internal::CaptureStdout();
+	std::cout << dna;
+	std::string out = testing::internal::GetCapturedStdout();
+	EXPECT_EQ(out.size(), 7);
+	EXPECT_EQ(out[4], 'G');
+}
+
+TEST(sequence_test, lazy_sequence_distinct) {
+	auto argv = get_argv({"./executable"});
+	tgen::register_gen(argv.size() - 1, argv.data());
+
+	EXPECT_THROW_TGEN_PREFIX(tgen::lazy_sequence<double>(3, 0, 1).distinct(),
+							 "distinct values must be integral or in a set");
+	EXPECT_THROW_TGEN_PREFIX(
+		tgen::lazy_sequence<int>(3, 1, 5).distinct().set(0, 1).gen(),
+		"distinct lazy sequences can not be combined with set");
+	EXPECT_THROW_TGEN_PREFIX(
+		tgen::lazy_sequence<int>(6, 1, 5).distinct().gen(),
+		"invalid lazy_sequence (contradicting constraints)");
+
+	// All values of the domain.
+	auto all = tgen::lazy_sequence<int>(1000, -500, 499).distinct().gen();
+	std::vector<int> vec = all.to_std();
+	std::sort(vec.begin(), vec.end());
+	for (int i = 0; i < 1000; ++i)
+		EXPECT_EQ(vec[i], i - 500);
+
+	// Distinct 64-bit keys, over the whole range.
+	auto keys = tgen::lazy_sequence<unsigned long long>(1e12, 0, ~0ULL)
+					.distinct()
+					.gen();
+	std::set<unsigned long long> seen;
+	for (long long i = 0; i < 1000; ++i)
+		seen.insert(keys[i * 999999937]);
+	EXPECT_EQ(seen.size(), 1000);
+
+	auto dna = tgen::lazy_sequence<char, tgen::set_domain<char>>(
+				   4, {'A', 'C', 'G', 'T'})
+				   .distinct()
+				   .gen();
+	std::set<char> letters;
+	for (int i = 0; i < 4; ++i)
+		letters.insert(dna[i]);
+	EXPECT_EQ(letters.size(), 4);
+}
+
 TEST(sequence_test, sequence_op_choose) {
 	auto argv = get_argv({"./executable"});
 	tgen::register_gen(argv.size() - 1, argv.data());
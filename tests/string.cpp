@@ -0,0 +1,136 @@
+#include <gtest/gtest.h>
+
+#include "tgen.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#define EXPECT_THROW_TGEN_PREFIX(stmt, prefix)                                 \
+	EXPECT_THROW(                                                              \
+		{                                                                      \
+			try {                                                              \
+				stmt;                                                          \
+				FAIL() << "Expected std::runtime_error, but no error ocurred"; \
+			} catch (const std::runtime_error &e) {                            \
+				std::string msg = e.what();                                    \
+				std::string tgen_pref = std::string("tgen: ") + prefix;        \
+				EXPECT_TRUE(msg.rfind(tgen_pref, 0) == 0)                      \
+					<< "Expected message to start with: \"" << tgen_pref       \
+					<< "\"\n"                                                  \
+					<< "Actual message: \"" << msg << "\"";                    \
+				throw e;                                                       \
+			}                                                                  \
+		},                                                                     \
+		std::runtime_error)
+
+inline std::vector<char *> get_argv(std::initializer_list<const char *> list) {
+	std::vector<char *> v;
+	for (auto s : list)
+		v.push_back(const_cast<char *>(s));
+	v.push_back(nullptr);
+	return v;
+}
+
+TEST(string_test, constructor) {
+	auto argv = get_argv({"./executable"});
+	tgen::register_gen(argv.size() - 1, argv.data());
+
+	EXPECT_THROW_TGEN_PREFIX(tgen::string(0, 'a', 'z'),
+							 "size must be positive");
+	EXPECT_THROW_TGEN_PREFIX(tgen::string(5, 'z', 'a'),
+							 "character range must be valid");
+	EXPECT_THROW_TGEN_PREFIX(tgen::string(5, std::set<char>()),
+							 "alphabet must be non-empty");
+	EXPECT_THROW_TGEN_PREFIX(tgen::string(5, 'a', 'c').set(0, 'd'),
+							 "character must be in the alphabet");
+	EXPECT_THROW_TGEN_PREFIX(tgen::string(5, 'a', 'c').set(5, 'a'),
+							 "index must be valid");
+	EXPECT_THROW_TGEN_PREFIX(tgen::string(5, 'a', 'c').palindrome(3, 5),
+							 "range indices must be valid");
+}
+
+TEST(string_test, gen) {
+	auto argv = get_argv({"./executable"});
+	tgen::register_gen(argv.size() - 1, argv.data());
+
+	// Printed without separators.
+	auto inst = tgen::string(20, 'a', 'z').set(0, 'x').gen();
+	testing::internal::CaptureStdout();
+	std::cout << inst;
+	std::string out = testing::internal::GetCapturedStdout();
+	EXPECT_EQ(out, inst.to_std());
+	EXPECT_EQ(out.size(), 20);
+	EXPECT_EQ(out[0], 'x');
+	for (char c : out)
+		EXPECT_TRUE('a' <= c and c <= 'z');
+
+	// Characters are uniform, for several alphabet sizes.
+	for (std::string alphabet :
+		 {"ab", "abc", "ACGT", "abcdefghijklmnopqrstuvwxyz"}) {
+		std::set<char> chars(alphabet.begin(), alphabet.end());
+		std::string str = tgen::string(200000, chars).gen().to_std();
+		std::map<char, int> count;
+		for (char c : str)
+			++count[c];
+		EXPECT_EQ(count.size(), alphabet.size());
+		for (auto [c, cnt] : count)
+			EXPECT_NEAR(cnt, 200000.0 / alphabet.size(),
+						5 * std::sqrt(200000.0 / alphabet.size()));
+	}
+	EXPECT_EQ(tgen::string(5, {'q'}).gen().to_std(), "qqqqq");
+
+	// Pairs of consecutive characters are independent.
+	std::string str = tgen::string(300000, 'a', 'c').gen().to_std();
+	std::map<std::string, int> pairs;
+	for (std::size_t i = 0; i + 1 < str.size(); i += 2)
+		++pairs[str.substr(i, 2)];
+	for (auto [pair, cnt] : pairs)
+		EXPECT_NEAR(cnt, 150000.0 / 9, 5 * std::sqrt(150000.0 / 9));
+}
+
+TEST(string_test, gen_constraints) {
+	auto argv = get_argv({"./executable"});
+	tgen::register_gen(argv.size() - 1, argv.data());
+
+	for (int i = 0; i < 20; ++i) {
+		auto str = tgen::string(11, 'a', 'b')
+					   .palindrome()
+					   .equal_range(2, 4)
+					   .set(1, 'b')
+					   .gen()
+					   .to_std();
+		EXPECT_EQ(str, std::string(str.rbegin(), str.rend()));
+		EXPECT_EQ(str[2], str[4]);
+		EXPECT_EQ(str[3], str[4]);
+		EXPECT_EQ(str[1], 'b');
+		EXPECT_EQ(str[9], 'b');
+	}
+	EXPECT_THROW_TGEN_PREFIX(
+		tgen::string(4, 'a', 'b').set(0, 'a').set(3, 'b').equal(0, 3).gen(),
+		"invalid sequence (contradicting constraints)");
+}
+
+TEST(string_test, gen_threads) {
+	// Output does not depend on the number of threads.
+	std::vector<std::string> strs;
+	for (const char *threads : {"--tgen-threads=1", "--tgen-threads=3"}) {
+		auto argv = get_argv({"./executable", threads});
+		tgen::register_gen(argv.size() - 1, argv.data());
+		strs.push_back(tgen::string(300000, 'a', 'z').gen().to_std());
+	}
+	EXPECT_EQ(strs[0], strs[1]);
+}
+
+TEST(string_test, instance) {
+	tgen::string::instance inst("cabca");
+	EXPECT_EQ(inst.size(), 5);
+	EXPECT_EQ(inst[1], 'a');
+	EXPECT_EQ(inst.sort().to_std(), "aabcc");
+	EXPECT_EQ(inst.reverse().to_std(), "ccbaa");
+	EXPECT_EQ((inst + tgen::string::instance("xy")).to_std(), "ccbaaxy");
+}
@@ -0,0 +1,169 @@
+#include <gtest/gtest.h>
+
+#include "tgen.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#define EXPECT_THROW_TGEN_PREFIX(stmt, prefix)                                 \
+	EXPECT_THROW(                                                              \
+		{                                                                      \
+			try {                                                              \
+				stmt;                                                          \
+				FAIL() << "Expected std::runtime_error, but no error ocurred"; \
+			} catch (const std::runtime_error &e) {                            \
+				std::string msg = e.what();                                    \
+				std::string tgen_pref = std::string("tgen: ") + prefix;        \
+				EXPECT_TRUE(msg.rfind(tgen_pref, 0) == 0)                      \
+					<< "Expected message to start with: \"" << tgen_pref       \
+					<< "\"\n"                                                  \
+					<< "Actual message: \"" << msg << "\"";                    \
+				throw e;                                                       \
+			}                                                                  \
+		},                                                                     \
+		std::runtime_error)
+
+inline std::vector<char *> get_argv(std::initializer_list<const char *> list) {
+	std::vector<char *> v;
+	for (auto s : list)
+		v.push_back(const_cast<char *>(s));
+	v.push_back(nullptr);
+	return v;
+}
+
+// Depth of each vertex of a tree instance.
+std::vector<int> depths(const tgen::tree::instance &inst) {
+	std::vector<int> depth(inst.size(), -1);
+	for (std::size_t v = 0; v < inst.size(); ++v) {
+		std::vector<int> path;
+		int u = v;
+		for (; u != -1 and depth[u] == -1; u = inst[u])
+			path.push_back(u);
+		int d = u == -1 ? -1 : depth[u];
+		for (auto it = path.rbegin(); it != path.rend(); ++it)
+			depth[*it] = ++d;
+	}
+	return depth;
+}
+
+TEST(tree_test, constructor) {
+	auto argv = get_argv({"./executable"});
+	tgen::register_gen(argv.size() - 1, argv.data());
+
+	EXPECT_THROW_TGEN_PREFIX(tgen::tree(0), "size must be positive");
+	EXPECT_THROW_TGEN_PREFIX(tgen::tree(5).caterpillar(6),
+							 "spine size must be from 1 to size");
+	EXPECT_THROW_TGEN_PREFIX(tgen::tree(5).max_depth(0),
+							 "depth must be positive");
+	EXPECT_THROW_TGEN_PREFIX(tgen::tree(5).path().star(),
+							 "tree can only have one shape");
+}
+
+TEST(tree_test, gen_uniform) {
+	auto argv = get_argv({"./executable"});
+	tgen::register_gen(argv.size() - 1, argv.data());
+
+	EXPECT_EQ(tgen::tree(1).gen().to_std(), std::vector<int>({-1}));
+
+	// The 4^2 labeled trees on 4 vertices are equally likely.
+	std::map<std::vector<std::pair<int, int>>, int> count;
+	const int samples = 32000;
+	for (int i = 0; i < samples; ++i) {
+		auto edges = tgen::tree(4).gen().edges();
+		for (auto &[u, v] : edges)
+			if (u > v)
+				std::swap(u, v);
+		std::sort(edges.begin(), edges.end());
+		++count[edges];
+	}
+	EXPECT_EQ(count.size(), 16);
+	for (auto [edges, cnt] : count)
+		EXPECT_NEAR(cnt, samples / 16.0, 5 * std::sqrt(samples / 16.0));
+
+	// The root is uniform.
+	std::vector<int> roots(5);
+	for (int i = 0; i < 5000; ++i)
+		++roots[tgen::tree(5).gen().root()];
+	for (int cnt : roots)
+		EXPECT_NEAR(cnt, 1000, 5 * std::sqrt(1000));
+}
+
+TEST(tree_test, gen_threads) {
+	// Output does not depend on the number of threads.
+	std::vector<std::vector<int>> trees;
+	for (const char *threads : {"--tgen-threads=1", "--tgen-threads=3"}) {
+		auto argv = get_argv({"./executable", threads});
+		tgen::register_gen(argv.size() - 1, argv.data());
+		trees.push_back(tgen::tree(300000).gen().to_std());
+	}
+	EXPECT_EQ(trees[0], trees[1]);
+}
+
+TEST(tree_test, gen_shapes) {
+	auto argv = get_argv({"./executable"});
+	tgen::register_gen(argv.size() - 1, argv.data());
+
+	for (int i = 0; i < 20; ++i) {
+		std::vector<int> depth = depths(tgen::tree(50).path().gen());
+		std::sort(depth.begin(), depth.end());
+		for (int v = 0; v < 50; ++v)
+			EXPECT_EQ(depth[v], v);
+
+		auto star = tgen::tree(50).star().gen();
+		for (int v = 0; v < 50; ++v)
+			EXPECT_EQ(star[v], v == star.root() ? -1 : star.root());
+
+		// Without the leaves, it is a path of at most 10 vertices.
+		auto caterpillar = tgen::tree(50).caterpillar(10).gen();
+		std::vector<int> children(50), inner_children(50);
+		for (int v = 0; v < 50; ++v)
+			if (caterpillar[v] != -1)
+				++children[caterpillar[v]];
+		int inner = 0;
+		for (int v = 0; v < 50; ++v)
+			if (children[v] > 0 or v == caterpillar.root()) {
+				++inner;
+				if (caterpillar[v] != -1)
+					++inner_children[caterpillar[v]];
+			}
+		EXPECT_LE(inner, 10);
+		EXPECT_LE(
+			*std::max_element(inner_children.begin(), inner_children.end()),
+			1);
+
+		for (int max_depth : {1, 2, 5}) {
+			std::vector<int> bounded =
+				depths(tgen::tree(50).max_depth(max_depth).gen());
+			EXPECT_EQ(*std::max_element(bounded.begin(), bounded.end()),
+					  max_depth);
+		}
+	}
+}
+
+TEST(tree_test, instance) {
+	EXPECT_THROW_TGEN_PREFIX(tgen::tree::instance({-1, -1, 1}),
+							 "tree must have exactly one root");
+	EXPECT_THROW_TGEN_PREFIX(tgen::tree::instance({-1, 2, 3, 1}),
+							 "tree cannot have cycles");
+	EXPECT_THROW_TGEN_PREFIX(tgen::tree::instance({-1, 3}),
+							 "parents must be from `-1` to `size-1`");
+
+	tgen::tree::instance inst = {-1, 0, 1, 1};
+	EXPECT_EQ(inst.root(), 0);
+	std::vector<std::pair<int, int>> edges = {{1, 0}, {2, 1}, {3, 1}};
+	EXPECT_EQ(inst.edges(), edges);
+	std::stringstream edge_list, parents;
+	edge_list << inst.add_1();
+	EXPECT_EQ(edge_list.str(), "2 1\n3 2\n4 2");
+	parents << inst.parents();
+	EXPECT_EQ(parents.str(), "0 1 2 2");
+
+	inst.reroot(3);
+	EXPECT_EQ(inst.to_std(), std::vector<int>({1, 3, 1, -1}));
+}